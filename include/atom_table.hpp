@@ -0,0 +1,87 @@
+#ifndef ATOM_TABLE_HPP
+#define ATOM_TABLE_HPP
+
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Atom that doesn't identify any spelling
+     */
+    const atom no_atom = 0;
+
+    /**
+     * Process wide interner that maps each distinct spelling (identifiers,
+     * header names, etc...) to an atom so they can be compared and used as
+     * indexes without hashing them again. Every spelling is stored only once
+     * and is never freed. The keywords are interned first so their atoms are
+     * the same as their keyword_type. All the methods are thread safe.
+     */
+	class atom_table
+	{
+        private:
+
+	    //{Private properties/members
+		std::shared_mutex m_mutex;                                  /*< Shared for lookups, exclusive to add spellings */
+		std::deque<std::string> m_storage;                          /*< Text of the spellings, never moved */
+		std::vector<std::string_view> m_spellings;                  /*< Spelling of every atom */
+		std::unordered_map<std::string_view, atom> m_atoms;         /*< Atom of every spelling */
+		//}
+
+        //{Private Methods
+		atom_table();
+
+		/**
+		 * The table shared by the whole process
+		 */
+		static atom_table& instance();
+
+		/**
+		 * Adds a spelling that is not on the table yet, the caller must hold the exclusive lock
+		 */
+		atom add(std::string_view spelling);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		atom_table(const atom_table &) = delete;
+		atom_table& operator=(const atom_table &) = delete;
+		//}
+
+		//{Methods
+		/**
+		 * Gets the atom of a spelling adding it to the table if new
+		 * @param spelling The text to intern, it is copied when new
+		 * @return The atom of the spelling
+		 */
+		static atom intern(std::string_view spelling);
+
+		/**
+		 * Gets the atom of a spelling without adding it
+		 * @param spelling The text to search
+		 * @return The atom of the spelling or no_atom if it was never interned
+		 */
+		static atom find(std::string_view spelling);
+
+		/**
+		 * The text of an atom, it stays valid until the process ends
+		 * @param value An atom returned by intern()
+		 */
+		static std::string_view get_spelling(atom value);
+
+		/**
+		 * Amount of atoms, including no_atom
+		 */
+		static size_t size();
+		//}
+	};
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef CHARACTER_SCANNER_HPP
+#define CHARACTER_SCANNER_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace cpp_parser
+{
+    //{Enumerations
+    /**
+     * Instruction set used by the character_scanner
+     */
+	enum scanner_level
+	{
+		scanner_scalar,     /*< One byte at a time */
+		scanner_sse2,       /*< 16 bytes at a time */
+		scanner_avx2        /*< 32 bytes at a time */
+	};
+	//}
+
+    /**
+     * Vectorized searches used by the tokenizer to skip over the bytes of long
+     * tokens: comments, strings, blanks and identifiers, and over the lines of
+     * inactive conditional groups. The best instruction
+     * set supported by the processor is selected at runtime, all of them give
+     * the same results as the scalar version.
+     */
+	class character_scanner
+	{
+        private:
+
+	    //{Private properties/members
+		static scanner_level m_level;   /*< Instruction set currently in use */
+		//}
+
+		public:
+
+		//{Setters
+		/**
+		 * Changes the instruction set used, levels not supported by the processor
+		 * are lowered to the best supported one.
+		 * @param level The instruction set to use
+		 */
+		static void set_level(scanner_level level);
+		//}
+
+		//{Getters
+		/**
+		 * The instruction set currently in use
+		 */
+		static scanner_level get_level(){ return m_level; }
+
+		/**
+		 * The best instruction set supported by the processor
+		 */
+		static scanner_level get_supported_level();
+		//}
+
+		//{Methods
+		/**
+		 * Finds the first byte that is not a blank (space, \t, \v, \f or \r)
+		 * @param characters The characters to scan
+		 * @param position Where to start scanning
+		 * @param size Amount of characters
+		 * @return Position of the byte or size if not found
+		 */
+		static size_t skip_blanks(const char *characters, size_t position, size_t size);
+
+		/**
+		 * Finds the first byte that can't be part of an identifier (a-z A-Z 0-9 _ $)
+		 * @param characters The characters to scan
+		 * @param position Where to start scanning
+		 * @param size Amount of characters
+		 * @return Position of the byte or size if not found
+		 */
+		static size_t skip_identifier(const char *characters, size_t position, size_t size);
+
+		/**
+		 * Finds the first string enclosure, escape (\) or new line character
+		 * @param characters The characters to scan
+		 * @param position Where to start scanning
+		 * @param size Amount of characters
+		 * @param enclosure The character that closes the string (" or ')
+		 * @return Position of the byte or size if not found
+		 */
+		static size_t find_string_special(const char *characters, size_t position, size_t size, char enclosure);
+
+		/**
+		 * Finds the * of the first end of comment sequence
+		 * @param characters The characters to scan
+		 * @param position Where to start scanning
+		 * @param size Amount of characters
+		 * @return Position of the * or size if not found
+		 */
+		static size_t find_comment_end(const char *characters, size_t position, size_t size);
+
+		/**
+		 * Finds the first byte that changes how the rest of a line is read: a new line,
+		 * the / of comments, string and character quotes and the \ of continued lines
+		 * @param characters The characters to scan
+		 * @param position Where to start scanning
+		 * @param size Amount of characters
+		 * @return Position of the byte or size if not found
+		 */
+		static size_t find_line_special(const char *characters, size_t position, size_t size);
+
+		/**
+		 * Finds where every line starts, the position after each new line
+		 * @param characters The characters to scan
+		 * @param size Amount of characters
+		 * @param starts The positions are appended to it
+		 */
+		static void find_line_starts(const char *characters, size_t size, std::vector<unsigned int> &starts);
+
+		/**
+		 * Counts the new lines
+		 * @param characters The characters to scan
+		 * @param size Amount of characters
+		 * @return Amount of \n bytes
+		 */
+		static size_t count_new_lines(const char *characters, size_t size);
+		//}
+	};
+};
+
+#endif
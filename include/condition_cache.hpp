@@ -0,0 +1,128 @@
+#ifndef CONDITION_CACHE_HPP
+#define CONDITION_CACHE_HPP
+
+#include <deque>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+#include "macro_table.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Operations of a compiled #if/#elif expression, they work on a stack of values
+     */
+	enum condition_opcode
+	{
+	    opcode_push,            /*< Pushes the operand as a signed value */
+	    opcode_push_unsigned,   /*< Pushes the operand as an unsigned value */
+	    opcode_macro,           /*< Pushes the value of the macro named by the operand atom, 0 if not defined */
+	    opcode_defined,         /*< Pushes 1 if the macro named by the operand atom is defined, 0 otherwise */
+	    opcode_unary,           /*< Applies the unary operator given by the operand TokenType to the top */
+	    opcode_binary,          /*< Replaces the two values on the top by the result of the binary operator given by the operand TokenType */
+	    opcode_select,          /*< Replaces the three values on the top by the second or the third depending on the first (?:) */
+	    opcode_to_bool,         /*< Replaces the top by 1 if it isn't 0 */
+	    opcode_and_jump,        /*< If the top is 0 jumps to the operand, otherwise pops it (&&) */
+	    opcode_or_jump,         /*< If the top is not 0 replaces it by 1 and jumps to the operand, otherwise pops it (||) */
+	    opcode_pop              /*< Drops the top (comma operator) */
+	};
+
+    /**
+     * A single operation of a compiled expression
+     */
+	struct condition_instruction
+	{
+	    condition_opcode opcode;
+	    std::uintmax_t operand; /*< Value, atom, operator or index of the instruction to jump to */
+	};
+
+    /**
+     * An #if/#elif expression compiled to a sequence of stack operations. Macros are
+     * referenced by name so the same code is valid whatever their current values are.
+     */
+	struct compiled_condition
+	{
+	    std::vector<condition_instruction> code;    /*< The operations, empty if the expression couldn't be compiled */
+	    unsigned int stack_size;                    /*< Maximum amount of values on the stack while running */
+	    size_t hash;                                /*< Hash of the text of the expression, to detect changed files */
+	};
+
+    /**
+     * Process wide cache of the compiled #if/#elif expressions found on each
+     * file, identified by the atom of the file path and the offset of the
+     * directive. Files included from many sources only compile their
+     * conditions once, evaluating them again just runs the operations
+     * against the current macros: the side of && and || that doesn't
+     * count is never evaluated. Both sides of ?: are, since the type of
+     * the result depends on both.
+     *
+     * Expressions that invoke function like macros, and macros whose value
+     * is not a single literal or identifier, can't be evaluated this way and
+     * have to be expanded and evaluated on the usual way. All the methods
+     * are thread safe.
+     */
+	class condition_cache
+	{
+        private:
+
+	    //{Private properties/members
+		std::shared_mutex m_mutex;                                                  /*< Shared for lookups, exclusive to add conditions */
+		std::deque<compiled_condition> m_conditions;                                /*< Never moved so references to them stay valid */
+		std::unordered_map<unsigned long long, const compiled_condition*> m_index; /*< File atom and offset to the condition */
+		//}
+
+        //{Private Methods
+		condition_cache(){}
+
+		/**
+		 * The cache shared by the whole process
+		 */
+		static condition_cache& instance();
+
+		/**
+		 * Compiles an expression
+		 * @param expression The tokens of the expression, without expanding macros
+		 * @param condition Where the code is stored, left empty if it can't be compiled
+		 */
+		static void compile(token_span expression, compiled_condition &condition);
+
+		/**
+		 * Gets the value of a macro used on an expression
+		 * @return false if its value is not a single literal or identifier
+		 */
+		static bool macro_value(const macro_table &macros, atom name, integer_literal &value);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		condition_cache(const condition_cache &) = delete;
+		condition_cache& operator=(const condition_cache &) = delete;
+		//}
+
+		//{Methods
+		/**
+		 * Gets the compiled form of an expression, compiling it the first time
+		 * @param file The atom of the full path of the file
+		 * @param offset Position of the directive on the file
+		 * @param expression The tokens of the expression, without expanding macros
+		 * @return The compiled expression, valid until the process ends
+		 */
+		static const compiled_condition& get(atom file, size_t offset, token_span expression);
+
+		/**
+		 * Evaluates a compiled expression with the current macros
+		 * @param condition The compiled expression
+		 * @param macros The defined macros
+		 * @param value Set to the result
+		 * @return false if the expression has to be evaluated by expanding its macros,
+		 * because of the macros used or because of an error like a division by zero
+		 */
+		static bool evaluate(const compiled_condition &condition, const macro_table &macros, integer_literal &value);
+		//}
+	};
+};
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef CONSTEXPR_HPP
 #define CONSTEXPR_HPP
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include "types.hpp"
 
 enum TokenType
 {
@@ -46,6 +49,11 @@ struct Token
 
 typedef const Token *PCToken;
 
+/**
+    \brief Value of a constant expression, signed values behave as intmax_t and unsigned ones as uintmax_t.
+*/
+typedef cpp_parser::integer_literal ExprValue;
+
 class PreprocessorError
 {
 public:
@@ -59,12 +67,38 @@ private:
     Token               mToken;
 };
 
+/**
+    \brief A token of a constant expression already classified, with the value of its literal decoded.
+*/
+struct ExprToken
+{
+    TokenType           type;
+    ExprValue           value;  // Value of ttNumber and ttCharLiteral tokens
+    std::string_view    text;   // Spelling of the token, only used on error messages
+};
+
+/**
+    \brief Outcome of evaluating a constant expression without exceptions.
+*/
+struct ExprResult
+{
+    ExprValue           value;      // Value of the expression, only meaningful when valid
+    bool                valid;      // false if the expression is malformed or divides by zero
+    std::string         message;    // Description of the error
+    const ExprToken *   token;      // Token where the error was found, null at the end of the expression
+};
+
 class ConstExprEvaluator
 {
     public:
         /**
-            \brief The function that evaluates the constant expression.
-            \return The value of truth of the constant expression.
+            \brief Evaluates a constant expression of classified tokens without throwing, valid
+            expressions are evaluated without allocating memory.
+            \param tokens The tokens of the expression, they can include ttWhiteSpace.
+            \param count The amount of tokens.
+            \param result Set to the value of the constant expression, with its signedness, or to the
+            first error found. Reusing it between calls reuses the storage of the message.
+            \return false if the expression is not valid.
 
             eval: \n
                  constant-expression \n
@@ -72,75 +106,115 @@ class ConstExprEvaluator
             constant-expression: \n
                  conditional-expression
         */
+        static bool eval(const ExprToken *tokens, size_t count, ExprResult &result);
+
+        /**
+            \brief Evaluates a constant expression of classified tokens.
+            \return The value of the constant expression, with its signedness.
+            \throw PreprocessorError If the expression is not valid.
+        */
+        static ExprValue eval(const ExprToken *tokens, size_t count);
+
+        /**
+            \brief The function that evaluates the constant expression.
+            \return The value of truth of the constant expression.
+
+            Decodes the literals of the tokens, up to ttEndOfTokens, and evaluates them
+            with the other eval.
+        */
         static int eval(PCToken *tokenIter);
 
+        /**
+            \brief Applies an unary operator (ttMinus, ttNot or ttBitNeg) with the rules of the preprocessor.
+        */
+        static ExprValue unary_operation(TokenType type, ExprValue operand);
+
+        /**
+            \brief Applies a binary operator with the rules of the preprocessor: if any operand is unsigned
+            both are converted to unsigned, shifts keep the type of the left operand and comparisons
+            and logical operators give a signed 0 or 1. Arithmetic wraps around instead of overflowing.
+            \param result Set to the result of the operation.
+            \return false on a division by zero.
+        */
+        static bool binary_operation(TokenType type, ExprValue left, ExprValue right, ExprValue &result);
+
     private:
+        /**
+            \brief Position on the tokens being evaluated.
+        */
+        struct Cursor
+        {
+            const ExprToken *   current;
+            const ExprToken *   end;
+            ExprResult *        result;     // Where the first error is recorded
+        };
+
+        /**
+            \brief Skips white space and gets the type of the next token, ttEndOfTokens at the end
+            and after an error so the evaluation unwinds without consuming more tokens.
+        */
+        static TokenType peek(Cursor &cursor);
+
+        /**
+            \brief Records an error for the token at the cursor, unless there is already one.
+        */
+        static void error(const std::string &message, const Cursor &cursor);
+
+        /**
+            \brief The spelling of the token at the cursor.
+        */
+        static std::string spelling(const Cursor &cursor);
+
+        /**
+            \brief Precedence of a binary operator, 0 if the token is not one.
+        */
+        static int binary_precedence(TokenType type);
+
+        /**
+            \brief Applies a binary operator.
+            \param evaluated false if the value doesn't count, errors are not reported then.
+        */
+        static ExprValue binary_operation(TokenType type, ExprValue left, ExprValue right, bool evaluated, const Cursor &cursor);
+
         /**
             \brief Evaluates a conditional expression.
+            \param evaluated false on the side of &&, || and ?: that doesn't count, errors like
+            a division by zero are ignored there.
 
             conditional-expression: \n
                  logical-or-expression \n
-                 logical-or-expression ? expression : assignment-expression
+                 logical-or-expression ? expression : conditional-expression
         */
-        static int conditional_expression(PCToken *tokenIter);
+        static ExprValue conditional_expression(Cursor &cursor, bool evaluated);
 
         /**
-            \brief Evaluates a logical-or-expression.
+            \brief Evaluates all the binary operators by precedence climbing, they are left associative.
+            \param minimumPrecedence Operators with a lower precedence end the expression.
 
             logical-or-expression: \n
                  logical-and-expression \n
                  logical-or-expression || logical-and-expression \n
-        */
-        static int logical_or_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates a logical-and-expression.
 
             logical-and-expression: \n
                  inclusive-or-expression \n
                  logical-and-expression && inclusive-or-expression
-        */
-        static int logical_and_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates an inclusive-or-expression.
 
             inclusive-or-expression: \n
                  exclusive-or-expression \n
                  inclusive-or-expression | exclusive-or-expression
-        */
-        static int inclusive_or_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates an exclusive-or-expression.
 
             exclusive-or-expression: \n
                  and-expression \n
                  exclusive-or-expression ^ and-expression
-        */
-        static int exclusive_or_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates an and-expression.
 
             and-expression: \n
                  equality-expression \n
                  and-expression & equality-expression \n
-        */
-        static int and_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates an equality-expression.
 
             equality-expression: \n
                  relational-expression \n
                  equality-expression == relational-expression \n
                  equality-expression != relational-expression
-        */
-        static int equality_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates a relational-expression.
 
             relational-expression: \n
                  shift-expression \n
@@ -148,31 +222,16 @@ class ConstExprEvaluator
                  relational-expression >  shift-expression \n
                  relational-expression <= shift-expression \n
                  relational-expression >= shift-expression
-        */
-        static int relational_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates a shift-expression.
 
             shift-expression: \n
                  additive-expression \n
                  shift-expression >> additive-expression \n
                  shift-expression << additive-expression
-        */
-        static int shift_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates an additive-expression.
 
             additive-expression: \n
                  multiplicative-expression \n
                  additive-expression + multiplicative-expression \n
                  additive-expression - multiplicative-expression
-        */
-        static int additive_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates a multiplicative-expression.
 
             multiplicative-expression:
                  unary-expression \n
@@ -180,7 +239,7 @@ class ConstExprEvaluator
                  multiplicative-expression / unary-expression \n
                  multiplicative-expression % unary-expression \n
         */
-        static int multiplicative_expression(PCToken *tokenIter);
+        static ExprValue binary_expression(Cursor &cursor, int minimumPrecedence, bool evaluated);
 
         /**
             \brief Evaluates an unary-expression.
@@ -189,7 +248,7 @@ class ConstExprEvaluator
                  primary-expression \n
                  unary-operator unary-expression
         */
-        static int unary_expression(PCToken *tokenIter);
+        static ExprValue unary_expression(Cursor &cursor, bool evaluated);
 
         /**
             \brief Evaluates a primary-expression.
@@ -197,18 +256,13 @@ class ConstExprEvaluator
             primary-expression: \n
                  literal \n
                  ( expression )
-        */
-        static int primary_expression(PCToken *tokenIter);
-
-        /**
-            \brief Evaluates a literal.
 
             literal: \n
                  pp-number \n
                  character-literal \n
                  boolean-literal
         */
-        static int literal(PCToken *tokenIter);
+        static ExprValue primary_expression(Cursor &cursor, bool evaluated);
 
         /**
             \brief Evaluates an expression.
@@ -217,7 +271,12 @@ class ConstExprEvaluator
                  conditional-expression \n
                  expression , conditional-expression
         */
-        static int expression(PCToken *tokenIter);
+        static ExprValue expression(Cursor &cursor, bool evaluated);
+
+        /**
+            \brief Decodes a pp-number or character-literal token.
+        */
+        static ExprValue literal(PCToken *tokenIter);
 };
 
 /**Example USAGE
@@ -0,0 +1,144 @@
+#ifndef FILE_CACHE_HPP
+#define FILE_CACHE_HPP
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include "types.hpp"
+#include "source_buffer.hpp"
+#include "source_manager.hpp"
+#include "tokenized_file.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * The lines of a file from a given position up to the end of the next
+     * conditional directive, as produced by preprocessor_tokenizer::tokenize_lines
+     */
+    struct token_chunk
+    {
+        tokenized_file lines;       /*< The tokens, they point into the source of the file */
+        size_t end_position;        /*< Where the tokenizer stopped */
+    };
+
+    /**
+     * A file on the cache, the content and the chunks already tokenized. It stays
+     * valid while referenced even if evicted from the cache.
+     */
+    struct cached_file
+    {
+        file_stamp stamp;                                                           /*< Version of the file that was loaded */
+        std::shared_ptr<const source_buffer> source;                                /*< The content */
+        source_location base;                                                       /*< Location of the content on the source_manager */
+        std::shared_mutex mutex;                                                    /*< Shared to find chunks, exclusive to add them */
+        std::unordered_map<size_t, std::shared_ptr<const token_chunk>> chunks;      /*< The chunks by the position where they start */
+        std::atomic<size_t> memory;                                                 /*< Bytes used by the content and the chunks */
+        std::atomic<unsigned long long> last_use;                                   /*< Tick of the cache when last used, for the LRU eviction */
+        bool cached;                                                                /*< false once evicted, guarded by the mutex of the cache */
+    };
+
+    /**
+     * Counters of a file_cache, to size its budget
+     */
+    struct file_cache_statistics
+    {
+        unsigned long long file_hits;       /*< Files found loaded with the same version */
+        unsigned long long file_misses;     /*< Files that had to be loaded */
+        unsigned long long chunk_hits;      /*< Chunks found already tokenized */
+        unsigned long long chunk_misses;    /*< Chunks that had to be tokenized */
+        unsigned long long evictions;       /*< Files removed to stay on the budget */
+        size_t memory;                      /*< Bytes used by the files on the cache */
+        size_t files;                       /*< Amount of files on the cache */
+    };
+
+    /**
+     * Content and tokens of the files read by the preprocessors, to load and
+     * tokenize each header once even if many translation units include it.
+     * Files are identified by device and inode and reloaded when their
+     * modification time or size changes. When the memory used goes over the
+     * budget the least recently used files are evicted.
+     *
+     * A cache can be shared by many preprocessor instances on different
+     * threads, all the methods are thread safe.
+     */
+	class file_cache
+	{
+        private:
+
+	    //{Private properties/members
+		mutable std::shared_mutex m_mutex;                                                          /*< Shared to find files, exclusive to add or evict them */
+		std::unordered_map<file_identity, std::shared_ptr<cached_file>, file_identity_hash> m_files;
+		std::atomic<size_t> m_budget;                                                               /*< Maximum bytes used by the files */
+		std::atomic<size_t> m_memory;                                                               /*< Bytes used by the files */
+		std::atomic<unsigned long long> m_clock;                                                    /*< Incremented on each use of a file */
+		std::atomic<unsigned long long> m_file_hits;
+		std::atomic<unsigned long long> m_file_misses;
+		std::atomic<unsigned long long> m_chunk_hits;
+		std::atomic<unsigned long long> m_chunk_misses;
+		std::atomic<unsigned long long> m_evictions;
+		//}
+
+        //{Private Methods
+        /**
+         * Removes the least recently used files until the memory used is on the budget,
+         * the caller must hold the exclusive lock
+         * @param keep A file that is not evicted, the one being used
+         */
+		void evict(const cached_file *keep);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+        /**
+         * @param budget Maximum amount of bytes used by the cached files
+         */
+		explicit file_cache(size_t budget = 256 * 1024 * 1024);
+
+		file_cache(const file_cache &) = delete;
+		file_cache& operator=(const file_cache &) = delete;
+		//}
+
+		//{Setters
+		/**
+		 * Changes the maximum amount of bytes used, files are evicted as needed
+		 */
+		void set_budget(size_t budget);
+		//}
+
+		//{Getters
+		/**
+		 * The current counters
+		 */
+		file_cache_statistics get_statistics() const;
+		//}
+
+		//{Methods
+		/**
+		 * Gets a file, loading it if not on the cache or if it changed
+		 * @param path Path of the file
+		 * @param stamp Identity and version of the file
+		 * @return The file or null if it can't be read
+		 */
+		std::shared_ptr<cached_file> get_file(const std::string &path, const file_stamp &stamp);
+
+		/**
+		 * Gets the lines of a file from a position up to the end of the next conditional
+		 * directive, tokenizing them the first time
+		 * @param file A file returned by get_file()
+		 * @param position Where the lines start, at the beginning of a line
+		 * @return The chunk, valid while referenced
+		 */
+		std::shared_ptr<const token_chunk> get_chunk(const std::shared_ptr<cached_file> &file, size_t position);
+
+		/**
+		 * Removes all the files
+		 */
+		void clear();
+		//}
+	};
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef INCLUDE_RESOLVER_HPP
+#define INCLUDE_RESOLVER_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "types.hpp"
+#include "atom_table.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Index of the include directory of a header that was not found on them,
+     * like the ones next to the file that includes them
+     */
+    const unsigned int no_directory = ~0u;
+
+    /**
+     * Finds the file named by an #include on the include directories. Every
+     * resolution is cached by the spelling of the header, its scope and the
+     * directory of the file that includes it, including the headers that
+     * were not found, so each one is searched once. Optionally the listing
+     * of each include directory is read the first time it is searched,
+     * which avoids a stat for the directories that don't have the header.
+     *
+     * The directories are numbered in the order they are searched, the local
+     * ones first, so #include_next can continue after the one that has the
+     * file with it.
+     */
+	class include_resolver
+	{
+        private:
+
+        /**
+         * An include directory
+         */
+        struct directory
+        {
+            std::string path;                           /*< Path ending with / */
+            bool listed;                                /*< true once entries was read */
+            std::unordered_set<std::string> entries;    /*< Names of the files and directories it has */
+        };
+
+        /**
+         * Result of a search
+         */
+        struct resolution
+        {
+            atom path;                  /*< Full path of the header, no_atom if not found */
+            unsigned int directory;     /*< Index of the include directory where it was found or no_directory */
+        };
+
+	    //{Private properties/members
+		std::vector<directory> m_local;                         /*< Searched for headers like #include "header.h" */
+		std::vector<directory> m_global;                        /*< Searched for headers like #include <header.h> and the "" ones not found */
+		std::unordered_map<unsigned long long, resolution> m_cache;         /*< Each resolution, including the headers not found */
+		std::unordered_map<unsigned long long, resolution> m_next_cache;    /*< Each resolution of #include_next by the directory it starts after */
+		bool m_listing;                                         /*< true to read the listing of the directories */
+		std::string m_path;                                     /*< Scratch to build the paths probed */
+		//}
+
+        //{Private Methods
+        /**
+         * Builds the list of include directories
+         */
+		static void set_directories(std::vector<directory> &directories, const std::vector<std::string> &paths);
+
+        /**
+         * Checks if a header is on a directory
+         * @param search_directory The directory
+         * @param file The header as written on the #include
+         * @return true if found, the full path is left on m_path
+         */
+		bool probe(directory &search_directory, std::string_view file);
+
+        /**
+         * Searches a header on the include directories
+         * @param file The header as written on the #include
+         * @param first Index of the first directory searched
+         * @return The header found on the first directory that has it
+         */
+		resolution search(std::string_view file, unsigned int first);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		include_resolver(): m_listing(true){}
+
+		include_resolver(const include_resolver &) = delete;
+		include_resolver& operator=(const include_resolver &) = delete;
+		//}
+
+		//{Setters
+		/**
+		 * Sets the directories searched for headers enclosed in "", it clears the cache
+		 */
+		void set_local_directories(const std::vector<std::string> &paths);
+
+		/**
+		 * Sets the directories searched for headers enclosed in <>, it clears the cache
+		 */
+		void set_global_directories(const std::vector<std::string> &paths);
+
+		/**
+		 * To read the listing of each directory once instead of probing each header on them
+		 * @param listing true by default
+		 */
+		void set_directory_listing(bool listing){ m_listing = listing; }
+		//}
+
+		//{Methods
+		/**
+		 * Finds a header. Headers enclosed in "" are searched on the directory of the file that
+		 * includes them, then on the local directories and then on the global ones.
+		 * @param file The header as written on the #include
+		 * @param scope local for headers enclosed in "", global for <>
+		 * @param includer_directory The atom of the directory of the file with the #include,
+		 * ending with /, or no_atom to not search it
+		 * @param directory If not null set to the index of the include directory where the header
+		 * was found, no_directory if it was not found on them
+		 * @return The atom of the full path of the header, no_atom if not found
+		 */
+		atom resolve(std::string_view file, file_scope scope, atom includer_directory = no_atom, unsigned int *directory = 0);
+
+		/**
+		 * Finds a header for #include_next, on the include directories that follow the one that
+		 * has the file with the directive. Headers enclosed in <> are not searched on the local ones.
+		 * @param file The header as written on the #include_next
+		 * @param scope local for headers enclosed in "", global for <>
+		 * @param after Index of the include directory of the file with the #include_next
+		 * @param directory Set to the index of the include directory where the header was found
+		 * @return The atom of the full path of the header, no_atom if not found
+		 */
+		atom resolve_next(std::string_view file, file_scope scope, unsigned int after, unsigned int &directory);
+
+		/**
+		 * Forgets all the resolutions
+		 */
+		void clear(){ m_cache.clear(); m_next_cache.clear(); }
+		//}
+	};
+};
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef MACRO_EXPANDER_HPP
+#define MACRO_EXPANDER_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+#include "macro_table.hpp"
+#include "tokenized_file.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * A token produced while expanding macros
+     */
+    struct expanded_token
+    {
+        preprocessor_token token;   /*< Text and type, produced tokens have the position of the macro that generated them */
+        unsigned int hide_set;      /*< Macros that can't be expanded again from this token, 0 for none */
+        bool leading_space;         /*< true if there was white space before the token */
+        bool from_source;           /*< true if the token comes unchanged from the input, false if produced by a macro */
+    };
+
+    /**
+     * Expands object and function like macros on token sequences following the
+     * rules of the standard: arguments are fully expanded before substitution
+     * unless used with # or ##, the result is rescanned with the rest of the
+     * input and hide sets stop a macro from expanding inside of itself.
+     *
+     * All the scratch storage (pending tokens, arguments, text
+     * of pasted and stringified tokens) is kept between calls and reused, so
+     * once warmed up expanding doesn't allocate memory.
+     */
+	class macro_expander
+	{
+        private:
+
+        /**
+         * Where the tokens to expand are read from: the lines of a file, a
+         * range of tokens or a range of already expanded tokens
+         */
+        struct token_reader
+        {
+            const tokenized_file *file;             /*< Lines that can be continued on, null if limited to a range */
+            size_t line;                            /*< Index of the line being read when reading a file */
+            const preprocessor_token *current;      /*< Next source token */
+            const preprocessor_token *end;          /*< End of the source tokens available */
+            const expanded_token *expanded;         /*< Next expanded token, when reading them */
+            const expanded_token *expanded_end;     /*< End of the expanded tokens */
+            const char *previous_end;               /*< End of the text of the previous source token, to detect spaces */
+            bool space;                             /*< true if white space was skipped before the next token */
+        };
+
+        /**
+         * Scratch storage of one level of expansion, arguments are expanded on the next level
+         */
+        struct expansion_frame
+        {
+            std::vector<expanded_token> pending;            /*< Tokens to rescan before reading more input, in reverse order */
+            std::vector<expanded_token> consumed;           /*< Tokens read while collecting arguments, to put them back on failure */
+            std::vector<expanded_token> arguments;          /*< Tokens of all the arguments of the current invocation */
+            std::vector<size_t> argument_starts;            /*< Index on arguments where each argument starts plus the end */
+            std::vector<expanded_token> expanded;           /*< Fully expanded arguments */
+            std::vector<size_t> expanded_starts;            /*< Index on expanded of each argument, or ~0 if not expanded yet */
+            std::vector<size_t> expanded_ends;              /*< End on expanded of each argument */
+            std::vector<expanded_token> result;             /*< Replacement list after substitution */
+        };
+
+        /**
+         * Element of the hide sets, each set is a chain of nodes that are shared between sets
+         */
+        struct hide_set_node
+        {
+            atom name;
+            unsigned int next;
+        };
+
+	    //{Private properties/members
+		const macro_table &m_macros;
+		std::vector<std::unique_ptr<expansion_frame>> m_frames;         /*< One per level of nested argument expansion */
+		std::vector<expanded_token> m_output;                           /*< Result of the last expansion */
+		std::vector<hide_set_node> m_hide_sets;                         /*< Node 0 is the empty set */
+		std::unordered_map<unsigned long long, unsigned int> m_hide_set_index;     /*< Set plus name to the resulting set */
+		std::vector<std::unique_ptr<char[]>> m_text_blocks;             /*< Text of pasted and stringified tokens */
+		size_t m_text_block;                                            /*< Block being filled */
+		size_t m_text_used;                                             /*< Bytes used of the block being filled */
+		std::vector<std::string> m_large_texts;                         /*< Texts that don't fit on a block */
+		std::string m_spelling;                                         /*< Scratch to build the text of new tokens */
+		tokenized_file m_pasted;                                        /*< Scratch storage to lex pasted tokens */
+		//}
+
+        //{Private Methods
+        /**
+         * Gets the scratch storage of a level of expansion, creating it the first time
+         */
+		expansion_frame& get_frame(unsigned int depth);
+
+		/**
+		 * Reads the next token from the pending tokens or the input
+		 * @param reader The input
+		 * @param pending Tokens to return before the input, in reverse order
+		 * @param token Where the token is stored
+		 * @param next_lines true to continue reading on the next code lines of a file
+		 * @return false if there are no more tokens
+		 */
+		bool next_token(token_reader &reader, std::vector<expanded_token> &pending, expanded_token &token, bool next_lines);
+
+		/**
+		 * Expands all the macros of the input
+		 * @param reader The input
+		 * @param output Where the tokens are appended
+		 * @param depth Level of nested argument expansion, to select the scratch storage
+		 */
+		void expand_tokens(token_reader &reader, std::vector<expanded_token> &output, unsigned int depth);
+
+		/**
+		 * Reads the arguments of a function like macro invocation
+		 * @param reader The input
+		 * @param frame Scratch storage where the arguments are stored
+		 * @param macro The macro invoked
+		 * @param closing Set to the hide set of the closing parenthesis
+		 * @return false if the macro name is not followed by valid arguments, the tokens read are put back
+		 */
+		bool read_arguments(token_reader &reader, expansion_frame &frame, const define &macro, unsigned int &closing);
+
+		/**
+		 * Replaces the parameters of the replacement list of a macro by its arguments
+		 * and applies the # and ## operators leaving the result on frame.result
+		 * @param frame Scratch storage with the arguments
+		 * @param macro The macro being expanded
+		 * @param name The macro name token that is being replaced
+		 * @param hide_set The hide set given to the resulting tokens
+		 * @param depth Level of the frame, arguments are expanded on the next one
+		 */
+		void substitute(expansion_frame &frame, const define &macro, const expanded_token &name, unsigned int hide_set, unsigned int depth);
+
+		/**
+		 * Fully expands an argument once and returns its range on frame.expanded
+		 */
+		void expand_argument(expansion_frame &frame, size_t argument, unsigned int depth, size_t &begin, size_t &end);
+
+		/**
+		 * Builds a string literal token with the spelling of an argument (# operator)
+		 */
+		expanded_token stringify(const expansion_frame &frame, size_t argument);
+
+		/**
+		 * Joins two tokens into one (## operator)
+		 * @return false if the result is not a single token
+		 */
+		bool paste(expanded_token &left, const expanded_token &right);
+
+		/**
+		 * Copies text to the scratch storage returning a view that is valid until the next expansion
+		 */
+		std::string_view store_text(const char *text, size_t size);
+
+		/**
+		 * Checks if a macro name is on a hide set
+		 */
+		bool hide_set_contains(unsigned int hide_set, atom name) const;
+
+		/**
+		 * Gets the hide set that results of adding a name to a set
+		 */
+		unsigned int hide_set_add(unsigned int hide_set, atom name);
+
+		/**
+		 * Gets the union of two hide sets
+		 */
+		unsigned int hide_set_union(unsigned int first, unsigned int second);
+
+		/**
+		 * Gets the intersection of two hide sets
+		 */
+		unsigned int hide_set_intersection(unsigned int first, unsigned int second);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+        /**
+         * @param macros The definitions used to expand, they are read when expanding so changes are seen
+         */
+		explicit macro_expander(const macro_table &macros);
+
+		macro_expander(const macro_expander &) = delete;
+		macro_expander& operator=(const macro_expander &) = delete;
+		//}
+
+		//{Methods
+		/**
+		 * Expands the macros of a code line. When a function like macro invocation
+		 * continues on the following lines they are read too, up to the next directive.
+		 * @param file The tokenized file
+		 * @param line Index of the line to expand, set to the last line read
+		 * @return The resulting tokens, valid until the next expansion
+		 */
+		const std::vector<expanded_token>& expand_line(const tokenized_file &file, size_t &line);
+
+		/**
+		 * Expands the macros of a range of tokens, for example a #if expression
+		 * @param tokens The tokens to expand
+		 * @return The resulting tokens, valid until the next expansion
+		 */
+		const std::vector<expanded_token>& expand(token_span tokens);
+		//}
+	};
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef MACRO_TABLE_HPP
+#define MACRO_TABLE_HPP
+
+#include <deque>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+#include "atom_table.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Identifies a macro stored on a macro_table, it stays valid until the
+     * macro is removed.
+     */
+    typedef unsigned int macro_handle;
+
+    /**
+     * Value of a macro_handle that doesn't identify any macro
+     */
+    const macro_handle no_macro = ~0u;
+
+    /**
+     * Storage of the macro definitions indexed by the atom of their name.
+     * Definitions are kept on slots that never move so lookups can return
+     * references and handles to them, removed slots are reused by the
+     * following definitions.
+     *
+     * The replacement lists are lexed once when stored and kept, together
+     * with their text, on an arena that only grows: they are immutable and
+     * stay valid for the life of the table even if the macro is removed.
+     */
+	class macro_table
+	{
+        private:
+
+        /**
+         * A stored definition and where it came from
+         */
+        struct macro_slot
+        {
+            define definition;
+            file_scope scope;   /*< global for user given definitions, local for the ones found on the sources */
+            bool used;          /*< false if the slot is free */
+        };
+
+	    //{Private properties/members
+		std::deque<macro_slot> m_slots;             /*< Never reallocated so references to them stay valid */
+		std::vector<macro_handle> m_free_slots;     /*< Slots of removed macros */
+		std::vector<macro_handle> m_index;          /*< Slot of the macro named by each atom, no_macro if not defined */
+		size_t m_count;                             /*< Amount of macros defined */
+		std::vector<std::unique_ptr<replacement_token[]>> m_token_blocks;   /*< Arena of the replacement lists */
+		replacement_token *m_token_next;                                    /*< First token not used of the last block */
+		size_t m_token_left;                                                /*< Tokens not used of the last block */
+		std::vector<std::unique_ptr<char[]>> m_text_blocks;                 /*< Arena of the text of the replacement lists */
+		char *m_text_next;                                                  /*< First byte not used of the last block */
+		size_t m_text_left;                                                 /*< Bytes not used of the last block */
+		//}
+
+        //{Private Methods
+        /**
+         * Gets storage for the given amount of tokens on the arena
+         */
+		replacement_token* allocate_tokens(size_t count);
+
+        /**
+         * Copies text to the arena
+         * @return A view of the stored copy
+         */
+		std::string_view store_text(std::string_view text);
+
+        /**
+         * Copies a replacement list to the arena classifying its tokens
+         * @param definition The macro, its parameters are used to classify the tokens
+         * @param tokens The replacement list, comments, new lines and \\ are skipped
+         */
+		void store_replacement(define &definition, token_span tokens);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		macro_table(): m_count(0), m_token_next(0), m_token_left(0), m_text_next(0), m_text_left(0){}
+
+		macro_table(const macro_table &) = delete;
+		macro_table& operator=(const macro_table &) = delete;
+		//}
+
+		//{Getters
+		/**
+		 * Finds a macro by the atom of its name
+		 * @param name The atom of the macro identifier
+		 * @return The handle of the macro or no_macro if not defined
+		 */
+		macro_handle find(atom name) const { return name < m_index.size() ? m_index[name] : no_macro; }
+
+		/**
+		 * Finds a macro by its name
+		 * @param name The identifier of the macro
+		 * @return The handle of the macro or no_macro if not defined
+		 */
+		macro_handle find(std::string_view name) const { return find(atom_table::find(name)); }
+
+		/**
+		 * Finds a macro by the atom of its name
+		 * @param name The atom of the macro identifier
+		 * @return The definition of the macro or null if not defined
+		 */
+		const define* lookup(atom name) const
+		{
+		    macro_handle handle = find(name);
+
+		    return handle != no_macro ? &m_slots[handle].definition : 0;
+		}
+
+		/**
+		 * Finds a macro by its name
+		 * @param name The identifier of the macro
+		 * @return The definition of the macro or null if not defined
+		 */
+		const define* lookup(std::string_view name) const { return lookup(atom_table::find(name)); }
+
+		/**
+		 * The definition of a macro
+		 * @param handle A handle returned by find() or add()
+		 */
+		const define& get(macro_handle handle) const { return m_slots[handle].definition; }
+
+		/**
+		 * Amount of macros defined
+		 */
+		size_t size() const { return m_count; }
+
+		/**
+		 * Copies the definitions of the given scope on the order of its slots
+		 * @param scope global for the user given definitions, local for the ones found on the sources
+		 */
+		std::vector<define> get_defines(file_scope scope) const;
+		//}
+
+		//{Methods
+		/**
+		 * Stores a definition replacing any previous one with the same name,
+		 * the replacement list is lexed from the definition value
+		 * @param definition The macro to store
+		 * @param scope global for user given definitions, local for the ones found on the sources
+		 * @return The handle of the stored macro
+		 */
+		macro_handle add(const define &definition, file_scope scope);
+
+		/**
+		 * Stores a definition replacing any previous one with the same name
+		 * @param definition The macro to store
+		 * @param replacement The tokens of the replacement list as found on the #define, they are copied
+		 * @param scope global for user given definitions, local for the ones found on the sources
+		 * @return The handle of the stored macro
+		 */
+		macro_handle add(const define &definition, token_span replacement, file_scope scope);
+
+		/**
+		 * Removes a definition (#undef) in constant time
+		 * @param name The atom of the macro identifier
+		 * @return true if the macro was defined false otherwise
+		 */
+		bool remove(atom name);
+
+		/**
+		 * Removes a definition (#undef) in constant time
+		 * @param name The identifier of the macro
+		 * @return true if the macro was defined false otherwise
+		 */
+		bool remove(std::string_view name){ return remove(atom_table::find(name)); }
+
+		/**
+		 * Removes all the definitions of a scope
+		 * @param scope global for user given definitions, local for the ones found on the sources
+		 */
+		void clear(file_scope scope);
+		//}
+	};
+};
+
+#endif
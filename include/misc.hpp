@@ -2,20 +2,30 @@
 #define MISC_HPP
 
 #include <string>
+#include <string_view>
+#include "types.hpp"
 
 namespace cpp_parser
 {
     /**
-     * Checks for the existance of a file
-     * @return true if file exists otherwise false
+     * Checks for the existance of a file, without opening it
+     * @return true if file exists and is not a directory otherwise false
      */
     bool file_exists(const std::string &file);
 
+    /**
+     * Gets the device, inode, modification time and size of a file
+     * @param file Path of the file
+     * @param stamp Set to the identity and version of the file
+     * @return false if the file doesn't exist
+     */
+    bool get_file_stamp(const std::string &file, file_stamp &stamp);
+
     /**
      * Counts the ocurrences of a character on a given string
      * @return The amount of characters found
      */
-    unsigned int count_character(const char &character, std::string &source);
+    unsigned int count_character(const char &character, std::string_view source);
 
     /**
      * The current version of cpp_parser library generated by autoversion system
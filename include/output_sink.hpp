@@ -0,0 +1,219 @@
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace cpp_parser
+{
+    /**
+     * Destination of the preprocessed code. Writes are gathered on a buffer
+     * without virtual calls and handed to the destination when it fills up,
+     * so the output is produced as the files are preprocessed instead of
+     * being kept in memory until the end.
+     */
+	class output_sink
+	{
+        private:
+
+	    //{Private properties/members
+		std::unique_ptr<char[]> m_buffer;
+		size_t m_capacity;
+		size_t m_used;
+		//}
+
+        //{Private Methods
+		output_sink(const output_sink &);
+		output_sink& operator=(const output_sink &);
+		//}
+
+        protected:
+
+        /**
+         * Hands the buffered bytes to the destination
+         * @param data The bytes
+         * @param size Amount of bytes
+         */
+		virtual void drain(const char *data, size_t size) = 0;
+
+		public:
+
+        //{Constructor and Destructor
+        /**
+         * @param capacity Size of the buffer
+         */
+		explicit output_sink(size_t capacity = 64 * 1024): m_buffer(new char[capacity]), m_capacity(capacity), m_used(0){}
+
+		/**
+		 * The derived classes have to call flush() on their destructor
+		 */
+		virtual ~output_sink(){}
+		//}
+
+		//{Methods
+		/**
+		 * Writes a sequence of bytes
+		 */
+		void write(const char *data, size_t size)
+		{
+		    if(size > m_capacity - m_used)
+		    {
+		        flush();
+
+		        //Big writes go straight to the destination
+		        if(size >= m_capacity)
+		        {
+		            drain(data, size);
+		            return;
+		        }
+		    }
+
+		    std::memcpy(m_buffer.get() + m_used, data, size);
+		    m_used += size;
+		}
+
+		/**
+		 * Writes a text
+		 */
+		void write(std::string_view text){ write(text.data(), text.size()); }
+
+		/**
+		 * Writes a single character
+		 */
+		void put(char character)
+		{
+		    if(m_used == m_capacity)
+		    {
+		        flush();
+		    }
+
+		    m_buffer[m_used++] = character;
+		}
+
+		/**
+		 * Writes a character many times, for example the spaces of an indentation
+		 */
+		void fill(char character, size_t count)
+		{
+		    while(count > 0)
+		    {
+		        if(m_used == m_capacity)
+		        {
+		            flush();
+		        }
+
+		        size_t amount = count < m_capacity - m_used ? count : m_capacity - m_used;
+
+		        std::memset(m_buffer.get() + m_used, character, amount);
+		        m_used += amount;
+		        count -= amount;
+		    }
+		}
+
+		/**
+		 * Hands everything written to the destination
+		 */
+		void flush()
+		{
+		    if(m_used > 0)
+		    {
+		        size_t used = m_used;
+		        m_used = 0;
+
+		        drain(m_buffer.get(), used);
+		    }
+		}
+		//}
+	};
+
+    /**
+     * Writes the output to a file descriptor, for example STDOUT_FILENO
+     */
+	class fd_sink: public output_sink
+	{
+        private:
+
+	    //{Private properties/members
+		int m_descriptor;
+		bool m_failed;      /*< true if a write failed, the following ones are ignored */
+		//}
+
+        protected:
+
+		void drain(const char *data, size_t size);
+
+		public:
+
+        //{Constructor and Destructor
+        /**
+         * @param descriptor Where to write, it is not closed
+         */
+		explicit fd_sink(int descriptor): m_descriptor(descriptor), m_failed(false){}
+
+		~fd_sink(){ flush(); }
+		//}
+
+		//{Getters
+		/**
+		 * To know if the output could not be written
+		 */
+		bool failed() const { return m_failed; }
+		//}
+	};
+
+    /**
+     * Writes the output to a standard stream
+     */
+	class ostream_sink: public output_sink
+	{
+        private:
+
+		std::ostream &m_stream;
+
+        protected:
+
+		void drain(const char *data, size_t size){ m_stream.write(data, size); }
+
+		public:
+
+        //{Constructor and Destructor
+		explicit ostream_sink(std::ostream &stream): m_stream(stream){}
+
+		~ostream_sink(){ flush(); }
+		//}
+	};
+
+    /**
+     * Keeps the output in memory
+     */
+	class string_sink: public output_sink
+	{
+        private:
+
+		std::string m_text;
+
+        protected:
+
+		void drain(const char *data, size_t size){ m_text.append(data, size); }
+
+		public:
+
+        //{Constructor and Destructor
+		string_sink(){}
+
+		~string_sink(){ flush(); }
+		//}
+
+		//{Getters
+		/**
+		 * Everything written, the text can be moved out of the sink
+		 */
+		std::string& str(){ flush(); return m_text; }
+		//}
+	};
+};
+
+#endif
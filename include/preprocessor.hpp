@@ -1,12 +1,21 @@
 #ifndef PREPROCESSOR_H
 #define PREPROCESSOR_H
 
-#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <exception>
 #include "types.hpp"
 #include "constexpr.hpp"
+#include "macro_table.hpp"
+#include "macro_expander.hpp"
+#include "include_resolver.hpp"
+#include "file_cache.hpp"
+#include "token_stream.hpp"
+#include "output_sink.hpp"
 
 namespace cpp_parser
 {
@@ -28,14 +37,82 @@ namespace cpp_parser
 	{
         private:
 
+        /**
+         * State of the innermost conditional group (#if, #ifdef, #ifndef up to its #endif)
+         */
+        enum condition_state
+        {
+            condition_taking,       /*< The current branch is taken, its lines are preprocessed */
+            condition_skipping,     /*< No branch was taken yet, a following #elif or #else can be */
+            condition_taken         /*< A previous branch was taken, the rest of the group is skipped */
+        };
+
+        /**
+         * Entry of the conditional stack
+         */
+        struct condition
+        {
+            condition_state state;
+            source_location location;   /*< Where the directive that opened the group is, for the errors */
+        };
+
+        /**
+         * What the directive handlers know about the directive and the file being preprocessed
+         */
+        struct directive_context
+        {
+            token_span tokens;                  /*< The tokens of the directive, starting with the # */
+            const std::string &file;            /*< The name of the file, as it was included */
+            atom file_atom;                     /*< The atom of the full path of the file */
+            atom directory;                     /*< The atom of the directory of the file, ending with / */
+            unsigned int search_directory;      /*< Index of the include directory that has the file, for #include_next */
+            size_t offset;                      /*< Position of the directive on the file */
+            size_t conditions_base;             /*< Size of the conditional stack when the file was started */
+            output_sink &output;                /*< Where the preprocessed code goes */
+            std::string presumed_file;          /*< File name set by #line, empty to use the real one */
+            int line_delta;                     /*< Added to the lines of the file to get the ones set by #line */
+            bool once;                          /*< true if the file has #pragma once */
+        };
+
+        /**
+         * What makes including a file again produce nothing, found the first time it is preprocessed
+         */
+        struct header_guard
+        {
+            atom macro;             /*< Macro of the #ifndef that wraps the whole file, no_atom if none */
+            bool once;              /*< true if the file has #pragma once */
+        };
+
+        typedef void (preprocessor::*directive_handler)(directive_context &context);
+
+        /**
+         * Entry of the table of directives, indexed by directive_type
+         */
+        struct directive_entry
+        {
+            directive_handler handler;          /*< null for the directives that are ignored */
+            bool conditional;                   /*< true if it runs on skipped groups too, to follow their nesting */
+        };
+
+        static const directive_entry m_directives[directive_count];
+
 	    //{Private properties/members
 		std::vector<includes> m_includes;
-		std::vector<define> m_local_defines;
-		std::vector<define> m_global_defines;
-		std::vector<std::string> m_local_includes;
-		std::vector<std::string> m_global_includes;
+		macro_table m_macros;
+		macro_expander m_expander;                                  /*< Uses m_macros so it must be declared after it */
+		std::vector<preprocessor_token> m_condition_tokens;         /*< Scratch for the tokens of #if expressions */
+		std::vector<ExprToken> m_expression_tokens;                 /*< Scratch for the classified tokens of #if expressions */
+		ExprResult m_expression_result;                             /*< Scratch for the result of evaluating #if expressions */
+		include_resolver m_resolver;                                /*< Finds the headers on the include directories */
 		std::vector<std::string> m_headers;
-		std::map<std::string, file_scope> m_headers_scope;
+		std::unordered_set<atom> m_parsed_headers;                  /*< Atoms of m_headers */
+		std::unordered_map<atom, file_scope> m_headers_scope;       /*< Scope of the headers by the atom of their name */
+		std::shared_ptr<file_cache> m_files;                        /*< Content and tokens of the files, can be shared */
+		std::unordered_map<atom, file_stamp> m_file_stamps;         /*< Identity and version of the files by the atom of their full path */
+		size_t m_stream_size;                                       /*< Files bigger than it are streamed instead of cached, 0 for none */
+		std::unordered_map<file_identity, header_guard, file_identity_hash> m_guards; /*< Guards of the files already preprocessed */
+		unsigned int m_include_depth;                               /*< Amount of files being preprocessed, to stop recursive includes */
+		std::vector<condition> m_conditions;                        /*< Conditional groups open on the files being preprocessed, innermost last */
 		std::vector<preprocessor_error> m_errors;
 		std::string m_file;
 		//}
@@ -43,61 +120,169 @@ namespace cpp_parser
         //{Private Methods
         /**
          * Removes the # and macro type (ex: include, define, if, etc) from the tokens vector (first 2 elements)
-         * @param definition_declaration vector/array of tokens part of a macro
-         * @return vector of tokens with the first 2 elements stripped out (# and macro type)
+         * @param definition_declaration span of tokens part of a macro
+         * @return span of tokens with the first 2 elements stripped out (# and macro type)
          */
-		std::vector<preprocessor_token> strip_macro_definition(const std::vector<preprocessor_token> &definition_declaration);
+		token_span strip_macro_definition(token_span definition_declaration);
 
         /**
-         * Checks if a given header file is already parsed/preprocessed
-         * @param file The name of the header file to check
-         * @return true if already parsed false otherwise
+         * Checks if a directive continues on the next line (ends with \\)
+         * @param directive The tokens of the directive
+         * @return true if the last token is a \\
          */
-		const bool is_header_parsed(const std::string &file)
-		{
-		    for(unsigned int i=0; i<m_headers.size(); i++)
-		    {
-		        if(m_headers[i] == file)
-		        {
-		            return true;
-		        }
-		    }
+		static bool is_continued(token_span directive);
 
-		    return false;
-		}
+        /**
+         * Checks if a given header file was already included, to list it once on the headers
+         * @param file The atom of the header file name to check
+         * @return true if already parsed false otherwise
+         */
+		const bool is_header_parsed(atom file){ return m_parsed_headers.count(file) > 0; }
 
 		/**
          * Parses a macro definition getting the type (function or identifier), name/identifier,
          * value and parameters if it's a function macro.
-         * @param define_declaration vector/array of tokens
+         * @param define_declaration span of tokens
+         * @param replacement Set to the tokens of the replacement list
          */
-		const define parse_define(const std::vector<preprocessor_token> &define_declaration);
+		const define parse_define(token_span define_declaration, token_span &replacement);
 
         /**
-         * Evaluates a macro expression/condition
-         * @param define_declaration A macro object
+         * Evaluates a macro expression/condition, invalid expressions are added to the errors and are false
+         * @param context The #if or #elif directive, with the file and offset that identify the cached condition
          * @return true if condition is true (duh!) false otherwise
          */
-		const bool parse_expression(const std::vector<preprocessor_token> &define_declaration);
+		const bool parse_expression(const directive_context &context);
 
 		/**
-		 * Helper function to add all errors (#error) encountered while preprocessing
-		 * @param error_declaration An error macro tokens
-		 * @param file The name of the file where the error was found
+		 * Adds an error found while preprocessing, with the file and line set by #line if any
+		 * @param context The directive being handled
+		 * @param message The description of the error
+		 * @param location Where the error is on the file
 		 */
-		void add_error(const std::vector<preprocessor_token> &error_declaration, const std::string& file);
+		void add_error(const directive_context &context, const std::string &message, source_location location);
+
+        /**
+         * Checks if the lines of the current group are preprocessed or skipped
+         */
+		bool is_active() const { return m_conditions.empty() || m_conditions.back().state == condition_taking; }
+
+        /**
+         * Preprocesses a file already found on the include directories
+         * @param file The name of the file, as it was included
+         * @param path The atom of the full path of the file
+         * @param output Where the source with the macros expanded is written
+         * @param search_directory Index of the include directory where the file was found, no_directory if none
+         */
+		void preprocess(const std::string &file, atom path, output_sink &output, unsigned int search_directory = no_directory);
+
+        /**
+         * Checks if a code line has an identifier that is currently a macro name
+         */
+		bool has_macros(token_span line) const;
+
+        /**
+         * Writes a code line as it is on the source, with its white space
+         * @param line The tokens of the line, they must point into the source
+         * @param source The content of the file
+         * @param output Where the line is written
+         */
+		static void write_source_line(token_span line, const source_buffer &source, output_sink &output);
+
+        /**
+         * Finds where a code line starts, before its indentation
+         * @param line The tokens of the line, they must point into the source
+         * @param source The content of the file
+         * @param base The location of the content
+         * @return The location of the first byte of the line or no_location if unknown
+         */
+		static source_location line_start(token_span line, const source_buffer &source, source_location base);
+
+        /**
+         * Checks if a line only has comments
+         */
+		static bool is_blank_line(token_span line);
+
+        /**
+         * Gets the macro of a directive that can start an include guard
+         * @param directive The tokens of the directive
+         * @param type The type of the directive
+         * @return The atom of X on #ifndef X, #if !defined X or #if !defined(X), no_atom otherwise
+         */
+		static atom guard_macro(token_span directive, directive_type type);
+
+        /**
+         * Checks if including a file again would produce nothing, because of #pragma once
+         * or because the macro of its include guard is defined
+         * @param identity The identity of the file
+         */
+		bool is_guarded(const file_identity &identity) const;
+
+        /**
+         * Gets the first token after the name of a directive, skipping comments
+         * @param directive The tokens of the directive
+         * @return The token or null if the directive has no operands
+         */
+		static const preprocessor_token* directive_operand(token_span directive);
+
+        /**
+         * Gets the macro name operand of #define, #undef, #ifdef, #ifndef, #elifdef and #elifndef
+         * @param context The directive, an error is added if the name is missing
+         * @return The token of the name or null if missing
+         */
+		const preprocessor_token* macro_name(const directive_context &context);
+
+        /**
+         * Opens a conditional group
+         * @param context The directive that opens it
+         * @param taken The result of its condition, ignored when the enclosing group is skipped
+         */
+		void open_condition(const directive_context &context, bool taken);
+
+        /**
+         * Starts a new branch of the innermost conditional group (#elif, #else, etc)
+         * @param context The directive that starts the branch
+         * @return true if no branch was taken yet so the condition of this one has to be checked
+         */
+		bool next_branch(const directive_context &context);
+
+        /**
+         * Finds and preprocesses the header of an #include or #include_next
+         * @param context The directive
+         * @param next true to search the header on the include directories after the one that has the file
+         */
+		void include_header(directive_context &context, bool next);
+
+		//{Directive handlers
+		void handle_define(directive_context &context);
+		void handle_undef(directive_context &context);
+		void handle_include(directive_context &context);
+		void handle_include_next(directive_context &context);
+		void handle_if(directive_context &context);
+		void handle_ifdef(directive_context &context);
+		void handle_ifndef(directive_context &context);
+		void handle_elif(directive_context &context);
+		void handle_elifdef(directive_context &context);
+		void handle_elifndef(directive_context &context);
+		void handle_else(directive_context &context);
+		void handle_endif(directive_context &context);
+		void handle_error(directive_context &context);
+		void handle_pragma(directive_context &context);
+		void handle_line(directive_context &context);
+		//}
 
         /**
          * Converts an expression from a #if, #else, etc to an array of elements with macros expanded
-         * @return Vector with tokens that can be used to evalulate the expression by the ConstExprEvaluator class.
+         * @return Vector with tokens that can be used to evalulate the expression by the ConstExprEvaluator class,
+         * valid until the next call.
          */
-		const std::vector<Token> expand_macro_expression(const std::vector<preprocessor_token> &expression);
+		const std::vector<ExprToken>& expand_macro_expression(token_span expression);
 		//}
 
 		public:
 
         //{Constructor and Destructor
-		preprocessor(){}
+		preprocessor(): m_expander(m_macros), m_files(new file_cache()), m_stream_size(64 * 1024 * 1024), m_include_depth(0){}
 
 		~preprocessor();
 		//}
@@ -107,38 +292,70 @@ namespace cpp_parser
 		 * To set the path of global includes used when searching for files on #include statements
 		 * @param global_includes array/vector of paths
 		 */
-		void set_global_includes(const std::vector<std::string> &global_includes){ m_global_includes = global_includes; }
+		void set_global_includes(const std::vector<std::string> &global_includes){ m_resolver.set_global_directories(global_includes); }
 
         /**
 		 * To set the path of local includes used when searching for files on #include statements
 		 * @param local_includes array/vector of paths
 		 */
-		void set_local_includes(const std::vector<std::string> &local_includes){ m_local_includes = local_includes; }
+		void set_local_includes(const std::vector<std::string> &local_includes){ m_resolver.set_local_directories(local_includes); }
+
+        /**
+         * To share the content and tokens of the files with other preprocessors, by default each one has its own cache
+         * @param cache The cache to use, it is used by many threads if the preprocessors are
+         */
+		void set_file_cache(const std::shared_ptr<file_cache> &cache){ m_files = cache; }
+
+        /**
+         * To read the listing of each include directory once instead of checking each header on all of them
+         * @param listing true by default
+         */
+		void set_directory_listing(bool listing){ m_resolver.set_directory_listing(listing); }
+
+        /**
+         * Files bigger than the given size are read and tokenized in batches with a token_stream
+         * instead of being loaded whole on the cache, so huge generated sources use bounded memory.
+         * The batches are of 1MB or of the given size if it is smaller.
+         * @param size Amount of bytes, 64MB by default, 0 to never stream
+         */
+		void set_stream_size(size_t size){ m_stream_size = size; }
 
         /**
          * To pass a list of predefined macro definitions to take into account when preprocessing source files
          * @param global_defines array/vector of denifitions
          */
-		void set_global_defines(const std::vector<define> &global_defines){ m_global_defines = global_defines; }
+		void set_global_defines(const std::vector<define> &global_defines);
 		//}
 
 		//{Getters
+        /**
+         * The cache of the content and tokens of the files, to check its counters
+         */
+		const std::shared_ptr<file_cache>& get_file_cache() const { return m_files; }
+
         /**
          * Gets a macro/definition by searching for it's identifier globally or locally
          * @param definition The identifier or name of the macro
-         * @return A define object with the details of the macro
+         * @return The details of the macro, valid until it is redefined or removed, null if not defined
          */
-		const define get_define(const std::string &definition);
+		const define* get_define(std::string_view definition) const { return m_macros.lookup(definition); }
+
+        /**
+         * Gets a macro/definition by the atom of its identifier
+         * @param definition The atom of the macro name
+         * @return The details of the macro, valid until it is redefined or removed, null if not defined
+         */
+		const define* get_define(atom definition) const { return m_macros.lookup(definition); }
 
         /**
          * The whole list of macro/defines stored as global (not found while parsing and manually passed by the user)
          */
-		const std::vector<define>& get_global_defines(){ return m_global_defines; }
+		const std::vector<define> get_global_defines() const { return m_macros.get_defines(global); }
 
         /**
          * The whole list of macro/defines stored as local (found while parsing/preprocessing the source)
          */
-		const std::vector<define>& get_local_defines(){ return m_local_defines; }
+		const std::vector<define> get_local_defines() const { return m_macros.get_defines(local); }
 
         /**
          * Complete list of header files that where parsed
@@ -150,7 +367,7 @@ namespace cpp_parser
          * @param file name of header file
          * @return global or local
          */
-		const file_scope get_header_scope(const std::string &file){ return m_headers_scope[file]; };
+		const file_scope get_header_scope(const std::string &file){ return m_headers_scope[atom_table::intern(file)]; };
 
 		/**
 		 *To get the list of #error encountered while preprocessing
@@ -167,23 +384,37 @@ namespace cpp_parser
 		 */
 		const std::string parse_file(const std::string &file = "", file_scope scope = local);
 
+		/**
+		 * Pre-process a c/c++ source file writing the result as it is produced
+		 * @param file the name of the file to preprocess
+		 * @param output Where the source with macros expanded is written, it is not flushed
+		 * @param scope the scope of the file (global or local) to know which paths to search on
+		 */
+		void parse_file(const std::string &file, output_sink &output, file_scope scope = local);
+
         /**
          * Check if a macro definition is already declared (useful for #ifdef)
          * @param definition The string/identifier of the macro
          */
-		const bool is_defined(const std::string &definition);
+		const bool is_defined(std::string_view definition) const { return m_macros.find(definition) != no_macro; }
+
+        /**
+         * Check if a macro definition is already declared by the atom of its identifier
+         * @param definition The atom of the macro name
+         */
+		const bool is_defined(atom definition) const { return m_macros.find(definition) != no_macro; }
 
         /**
          * Removes a macro definition (useful for #undef)
          * @param definition The string/identifier of the macro
          */
-		const bool remove_define(const std::string &definition);
+		const bool remove_define(std::string_view definition){ return m_macros.remove(definition); }
 
         /**
-         * Checks where a header file declaration (ex: #include "file.h") resides
+         * Checks where a header file declaration (ex: #include "file.h") resides, the result is cached
          * @param file The name of the header file
          * @param scope To know where to check for the existance of the file
-         * @return full path of the header file on the system
+         * @return full path of the header file on the system, empty if not found
          */
 		const std::string file_path(const std::string &file, file_scope scope = local);
 		//}
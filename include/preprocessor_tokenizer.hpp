@@ -2,8 +2,10 @@
 #define PREPROCESSOR_TOKENIZER_CPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include "types.hpp"
+#include "tokenized_file.hpp"
 
 namespace cpp_parser
 {
@@ -16,57 +18,189 @@ namespace cpp_parser
 	{
         private:
 
+        /**
+         * Where the tokenizer stops before the end of the characters
+         */
+        struct stop_condition
+        {
+            bool conditionals;      /*< Stop after the first line that completes a conditional directive (#if, #ifdef, #ifndef, #elif, #else) */
+            size_t batch_size;      /*< Stop on the first line end that splits the lines safely past this many bytes, 0 to not stop */
+            bool partial;           /*< More characters follow, a line with a comment or literal that is not closed is left for the next call */
+        };
+
 	    //{Private static methods
 	    /**
-         * Checks if a given byte is an operator. Could be aritmethic,
-         * logical, macro concatenation, assignment or bit operator.
-         * @param byte The character to check
-         * @return true if is one of the operators given on the description, false otherwise.
+         * Helper function for the tokenizer methods to correctly add a token to a vector of tokens
+         * @param token view of the token characters on the source
+         * @param location where the token starts, no_location if the source has none
+         * @param type Type of token
+         * @param tokens reference to the vector that will store the token
+         * @param id atom of identifiers or punctuator_type of punctuators
+         */
+		static void add_token(std::string_view token, source_location location, token_type type, std::vector<preprocessor_token> &tokens, unsigned int id = 0);
+
+        /**
+         * Tokenizes a buffer storing the lines on the given tokenized file
+         * @param characters Pointer to the first byte to tokenize
+         * @param size Amount of bytes to tokenize
+         * @param position Where to start, at the beginning of a line. Set to where it stopped.
+         * @param stop Where to stop before the end
+         * @param file Where to store the tokens and its lines, the tokens are located from its base
+         */
+		static void tokenize(const char *characters, size_t size, size_t &position, const stop_condition &stop, tokenized_file &file);
+
+        /**
+         * Packs the value of a literal on the id of its token
+         * @param decoded false if the literal couldn't be decoded
+         * @param value The decoded value
+         * @return The id, 0 if the value doesn't fit and has to be decoded from the text
+         */
+		static unsigned int pack_literal(bool decoded, const integer_literal &value);
+		//}
+
+	    public:
+
+        //{Public statuc methods
+        /**
+         * Opens a file and tokenizes it (depends internally on tokenize_string method).
+         * Regular files are memory mapped and tokenized in place. The file is added to
+         * the source_manager so the locations of its tokens can be resolved.
+         * @param file_name The path of the file to tokenize or "-" for stdin
+         * @return The tokens with its line index and the buffer they point to
+         */
+		static tokenized_file tokenize_file(const std::string &file_name);
+
+        /**
+         * Tokenizes a given string, the characters are copied so the tokens don't depend on it
+         * @param cahracters The string to tokenize
+         * @return The tokens with its line index and the buffer they point to
+         */
+		static tokenized_file tokenize_string(const std::string &characters);
+
+        /**
+         * Tokenizes a buffer in place, without copying it
+         * @param characters Pointer to the first byte to tokenize, must outlive the returned tokens
+         * @param size Amount of bytes to tokenize
+         * @return The tokens with its line index
+         */
+		static tokenized_file tokenize_string(const char *characters, size_t size);
+
+        /**
+         * Tokenizes a buffer in place appending the tokens and lines to an existing file,
+         * useful to reuse the storage of a cleared file
+         * @param characters Pointer to the first byte to tokenize, must outlive the tokens
+         * @param size Amount of bytes to tokenize
+         * @param file Where to append the tokens
+         */
+		static void tokenize_string(const char *characters, size_t size, tokenized_file &file);
+
+        /**
+         * Tokenizes a buffer in place up to the end of the next conditional directive (#if,
+         * #ifdef, #ifndef, #elif, #else) so the preprocessor can decide if the lines that
+         * follow have to be tokenized or skipped with skip_group
+         * @param characters Pointer to the first byte of the buffer, must outlive the tokens
+         * @param size Amount of bytes of the buffer
+         * @param position Where to start, at the beginning of a line. Set to where it stopped.
+         * @param file Where to append the tokens, they are located from its base
+         */
+		static void tokenize_lines(const char *characters, size_t size, size_t &position, tokenized_file &file);
+
+        /**
+         * Tokenizes a batch of lines of a source that is read in parts. The batch ends on the first
+         * line end past batch_size bytes where no directive continues with \, no parenthesis is open
+         * and the line doesn't end with an identifier, so a function like macro invocation is never
+         * split between two batches.
+         * @param characters Pointer to the first byte of the buffer, must outlive the tokens
+         * @param size Amount of bytes of the buffer, ending on a new line unless it is the end of the source
+         * @param position Where to start, at the beginning of a line. Set to where it stopped, the lines
+         * after it are tokenized on the next call with more characters after them.
+         * @param batch_size Amount of bytes after which the batch can end
+         * @param end_of_source false if more characters follow the buffer, a comment or literal that
+         * is not closed is then left for the next call
+         * @param file Where to append the tokens, they are located from its base
          */
-		static bool is_operator(const char &byte);
+		static void tokenize_batch(const char *characters, size_t size, size_t &position, size_t batch_size, bool end_of_source, tokenized_file &file);
 
         /**
-         * Checks the type of operator on a given byte
-         * @param byte The character to check
-         * @return token_type
+         * Skips the lines of an inactive conditional group without tokenizing them. Only the
+         * name of the directives is read, to follow the nesting of conditionals, comments and
+         * literals are skipped so a # inside of them doesn't start a directive.
+         * @param characters Pointer to the first byte of the buffer
+         * @param size Amount of bytes of the buffer
+         * @param position Start of the line after the directive that began the group. Set to the
+         * start of the line of the #elif, #else or #endif that ends it, or size if there isn't one.
          */
-		static token_type get_operator_type(const char &byte);
+		static void skip_group(const char *characters, size_t size, size_t &position);
 
         /**
          * Checks the type of a given token
          * @param token The string to check for its type
-         * @return token_type
+         * @return keyword if the token is a c/c++ keyword, identifier otherwise
          */
-		static token_type get_identifier_type(const std::string &token);
+		static token_type get_identifier_type(std::string_view token);
 
         /**
-         * Helper function for the tokenizer methods to correctly add a token to a vector of tokens
-         * calculating correct column position when neccesary
-         * @param token string representation of the token
-         * @param line current line number where the token resides
-         * @param column current column number where the token starts
-         * @param type Type of token
-         * @param tokens reference to the vector that will store the token
+         * Finds which keyword is a given identifier with a perfect hash, without allocating
+         * @param token The identifier to check
+         * @return keyword_type or no_keyword if it isn't one
          */
-		static void add_token(const std::string &token, unsigned int line, unsigned int column, token_type type, std::vector<preprocessor_token> &tokens);
-		//}
+		static keyword_type get_keyword_type(std::string_view token);
 
-	    public:
+        /**
+         * Finds which preprocessor directive is a given name (the identifier after #)
+         * @param token The name of the directive
+         * @return directive_type or no_directive if unknown
+         */
+		static directive_type get_directive_type(std::string_view token);
 
-        //{Public statuc methods
         /**
-         * Opens a file and tokenizes it (depends internally on tokenize_string method)
-         * @param file_name The path of the file to tokenize
-         * @return Vector that symbolyze lines with an array/vector of tokens
+         * Finds which preprocessor directive is the identifier with the given atom
+         * @param name The atom of the identifier after #
+         * @return directive_type or no_directive if unknown
          */
-		static std::vector< std::vector<preprocessor_token> > tokenize_file(const std::string &file_name);
+		static directive_type get_directive_type(atom name);
 
         /**
-         * Tokenizes a given string
-         * @param cahracters The string to tokenize
-         * @return Vector that symbolyze lines with an array/vector of tokens
+         * Finds which keyword is the identifier with the given atom, keywords are the first atoms
+         * @param name The atom of the identifier
+         * @return keyword_type or no_keyword if it isn't one
+         */
+		static keyword_type get_keyword_type(atom name){ return name < keyword_count ? static_cast<keyword_type>(name) : no_keyword; }
+
+        /**
+         * The spelling of a keyword
+         * @param keyword The keyword to get
+         * @return The keyword text or an empty string for no_keyword
+         */
+		static std::string_view get_keyword_name(keyword_type keyword);
+
+        /**
+         * Decodes an integer literal, decimal, octal, hexadecimal or binary, with its u, l, ll and z suffixes.
+         * Values that don't fit on intmax_t become unsigned like on #if expressions.
+         * @param token The text of a number token
+         * @param value Set to the value of the literal
+         * @return false if the token is not a valid integer literal, for example a floating one or one that overflows
+         */
+		static bool decode_integer(std::string_view token, integer_literal &value);
+
+        /**
+         * Decodes a character literal with its escape sequences, multicharacter literals
+         * are combined a byte for each character. The value is converted to the type
+         * given by the encoding prefix.
+         * @param token The text of a character literal, it can include an encoding prefix
+         * @param value Set to the value of the literal
+         * @return false if the token is not a valid character literal
+         */
+		static bool decode_character(std::string_view token, integer_literal &value);
+
+        /**
+         * Gets the value of a number or character literal token. Small values are
+         * decoded by the tokenizer and kept on the token id, the rest are decoded now.
+         * @param token The token
+         * @param value Set to the value of the literal
+         * @return false if the token is not an integer or character literal
          */
-		static std::vector< std::vector<preprocessor_token> > tokenize_string(const std::string &characters);
+		static bool get_literal(const preprocessor_token &token, integer_literal &value);
 		//}
 	};
 };
@@ -0,0 +1,100 @@
+#ifndef SOURCE_BUFFER_HPP
+#define SOURCE_BUFFER_HPP
+
+#include <string>
+#include <cstddef>
+
+namespace cpp_parser
+{
+    /**
+     * Read only content of a source file. Regular files are memory mapped so
+     * the tokenizer can lex them in place, anything else (pipes, stdin, etc...)
+     * is read in bulk into a heap buffer.
+     */
+	class source_buffer
+	{
+        private:
+
+	    //{Private properties/members
+		const char *m_data;     /*< Start of the content */
+		size_t m_size;          /*< Amount of bytes on the content */
+		bool m_mapped;          /*< true if m_data points to a memory mapped region */
+		std::string m_content;  /*< Storage used when the content is not memory mapped */
+		//}
+
+        //{Private Methods
+        /**
+         * Reads everything available on a file descriptor into m_content
+         * @param descriptor The file descriptor to read from
+         * @param size_hint Expected amount of bytes or 0 if unknown
+         * @return true on success false otherwise
+         */
+		bool read_descriptor(int descriptor, size_t size_hint);
+
+		/**
+		 * Unmaps or frees the current content
+		 */
+		void release();
+
+		source_buffer(const source_buffer &);
+		source_buffer& operator=(const source_buffer &);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		source_buffer();
+
+		~source_buffer();
+		//}
+
+		//{Methods
+		/**
+		 * Loads the content of a file, the special name "-" reads from stdin.
+		 * @param file_name Path of the file to load
+		 * @return true on success false otherwise
+		 */
+		bool open(const std::string &file_name);
+
+		/**
+		 * Loads the content of an already opened file descriptor which is not closed.
+		 * @param descriptor The file descriptor to load
+		 * @return true on success false otherwise
+		 */
+		bool open(int descriptor);
+
+		/**
+		 * Copies a string as the content of the buffer
+		 * @param content The characters to store
+		 */
+		void assign(const std::string &content);
+
+		/**
+		 * Changes the size of a content filled by the caller, for example when it is
+		 * read in blocks. The bytes already on it are kept, a mapped content is copied.
+		 * @param size Amount of bytes
+		 * @return Pointer to the first byte, valid until the content changes again
+		 */
+		char* resize(size_t size);
+		//}
+
+		//{Getters
+		/**
+		 * Pointer to the first byte of the content, not null terminated.
+		 */
+		const char* data() const { return m_data; }
+
+		/**
+		 * Amount of bytes on the content
+		 */
+		size_t size() const { return m_size; }
+
+		/**
+		 * To know if the content is memory mapped or was read into memory
+		 */
+		bool is_mapped() const { return m_mapped; }
+		//}
+	};
+};
+
+#endif
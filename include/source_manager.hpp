@@ -0,0 +1,155 @@
+#ifndef SOURCE_MANAGER_HPP
+#define SOURCE_MANAGER_HPP
+
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "types.hpp"
+#include "atom_table.hpp"
+#include "source_buffer.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Location that doesn't belong to any file, for tokens that are not on a
+     * source (pasted, stringified, etc...) or when the location space runs out
+     */
+    const source_location no_location = 0;
+
+    /**
+     * Line and column of a source_location
+     */
+    struct resolved_location
+    {
+        atom file;              /*< Atom of the name the file was added with */
+        unsigned int line;      /*< Starting from 1 */
+        unsigned int column;    /*< Starting from 1, counted in bytes */
+    };
+
+    /**
+     * Process wide map of the locations of the tokens to their files, lines and
+     * columns. Each file added gets a range of a single 64 bit location space,
+     * the location of a byte is the base of its file plus its offset, so the
+     * tokenizer doesn't have to count lines or columns. They are found only when
+     * needed (errors, #line, definitions) with a binary search over the files
+     * and another over the starts of the lines of the file, which are found
+     * with a vectorized scan the first time a location of the file is resolved.
+     * The ranges of the contents that are dropped, like the batches of a
+     * streamed file, can be removed so the map doesn't grow with them.
+     * All the methods are thread safe.
+     */
+	class source_manager
+	{
+        private:
+
+        /**
+         * A file added to the location space
+         */
+        struct source_file
+        {
+            source_location base;                       /*< Location of the first byte */
+            size_t size;                                /*< Amount of bytes */
+            atom name;
+            unsigned long long first_line;              /*< Line of the first byte, files streamed in parts don't start on 1 */
+            std::weak_ptr<const source_buffer> source;  /*< The content, to find the lines */
+            bool lines_found;                           /*< true once line_starts was filled */
+            std::vector<unsigned int> line_starts;      /*< Offset of the first byte of each line, files are smaller than 4GB */
+        };
+
+        /**
+         * Range of a file read from the disk, kept while the file doesn't change
+         */
+        struct stamped_file
+        {
+            file_stamp stamp;           /*< The version of the file that has the range */
+            source_location base;
+        };
+
+	    //{Private properties/members
+		std::shared_mutex m_mutex;                  /*< Shared to resolve locations, exclusive to add files or find their lines */
+		std::map<source_location, source_file> m_files;     /*< The files by base, never moved */
+		source_location m_next;                     /*< Base of the next file added */
+		std::unordered_map<file_identity, stamped_file, file_identity_hash> m_stamped;  /*< Files added by their identity */
+		//}
+
+        //{Private Methods
+		source_manager(): m_next(1){}
+
+		/**
+		 * The manager shared by the whole process
+		 */
+		static source_manager& instance();
+
+		/**
+		 * Gives a file a new range of locations, the lock must be held
+		 */
+		source_location add(const std::shared_ptr<const source_buffer> &source, atom name, unsigned long long first_line);
+
+		/**
+		 * Finds the file of a location, the lock must be held
+		 * @return null if the location is not on any file
+		 */
+		source_file* find(source_location location);
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		source_manager(const source_manager &) = delete;
+		source_manager& operator=(const source_manager &) = delete;
+		//}
+
+		//{Methods
+		/**
+		 * Gives a file a range of locations, one for each byte plus one for its end
+		 * @param source The content of the file, it is not kept alive by the manager
+		 * @param name The atom of the name or path of the file
+		 * @param first_line The line of the first byte, for a part of a bigger file
+		 * @return The location of the first byte or no_location if the location space is full or
+		 * the file has 4GB or more
+		 */
+		static source_location add_file(const std::shared_ptr<const source_buffer> &source, atom name, unsigned long long first_line = 1);
+
+		/**
+		 * Gives a file read from the disk a range of locations. A file that is added again
+		 * without changes, like when it is loaded again after leaving a cache, keeps its range.
+		 * @param source The content of the file, it is not kept alive by the manager
+		 * @param name The atom of the name or path of the file
+		 * @param stamp Identity and version of the file
+		 * @return The location of the first byte or no_location if the location space is full
+		 */
+		static source_location add_file(const std::shared_ptr<const source_buffer> &source, atom name, const file_stamp &stamp);
+
+		/**
+		 * Removes the range of a file whose content was dropped, its locations can't be resolved any more
+		 * @param base The location of the first byte of the file, as given when it was added
+		 */
+		static void remove_file(source_location base);
+
+		/**
+		 * Finds the file, line and column of a location
+		 * @param location The location of a byte
+		 * @param resolved Set to the position of the byte
+		 * @return false for no_location, if the file was removed or if the content of the
+		 * file was freed before any of its locations was resolved
+		 */
+		static bool resolve(source_location location, resolved_location &resolved);
+
+		/**
+		 * The line of a location
+		 * @param location The location of a byte
+		 * @return The line starting from 1 or 0 if it can't be resolved
+		 */
+		static unsigned int get_line(source_location location);
+
+		/**
+		 * Amount of locations used, including no_location
+		 */
+		static size_t size();
+		//}
+	};
+};
+
+#endif
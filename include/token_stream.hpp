@@ -0,0 +1,112 @@
+#ifndef TOKEN_STREAM_HPP
+#define TOKEN_STREAM_HPP
+
+#include <memory>
+#include <string>
+#include "types.hpp"
+#include "atom_table.hpp"
+#include "source_buffer.hpp"
+#include "tokenized_file.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Pull based tokenizer for sources too big to be loaded whole, for example
+     * generated tables of hundreds of megabytes or a pipe. The source is read in
+     * blocks and handed out as batches of lines, each one on its own buffer with
+     * the bytes the previous batch left: the lines of a comment or literal that
+     * continues on the next block and the ones that can't be split from the lines
+     * that follow (see preprocessor_tokenizer::tokenize_batch). Only the current
+     * batch is kept in memory whatever the size of the source, unless a comment
+     * or a parenthesis is left open for longer than a batch. Each batch is added
+     * to the source_manager and removed from it when the next one is read, the
+     * positions and lines on the source are 64 bit.
+     */
+	class token_stream
+	{
+        private:
+
+	    //{Private properties/members
+		int m_descriptor;                       /*< Where the source is read from, -1 if not open */
+		bool m_owned;                           /*< true to close the descriptor */
+		bool m_end;                             /*< true once everything was read */
+		bool m_failed;                          /*< true if a read failed */
+		atom m_name;                            /*< Name of the source for the source_manager */
+		size_t m_batch_size;                    /*< Amount of bytes read for each batch */
+		std::shared_ptr<source_buffer> m_tail;  /*< Buffer of the last batch, its bytes from m_tail_position were not tokenized */
+		size_t m_tail_position;
+		source_location m_base;                 /*< Location of the last batch on the source_manager */
+		unsigned long long m_position;          /*< Position on the source of the first byte of the last batch */
+		unsigned long long m_line;              /*< Line of the first byte of the last batch */
+		//}
+
+		public:
+
+        //{Private Methods
+        /**
+         * Removes the last batch from the source_manager
+         */
+		void release();
+		//}
+
+        //{Constructor and Destructor
+        /**
+         * @param batch_size Amount of bytes read for each batch
+         */
+		explicit token_stream(size_t batch_size = 1024 * 1024);
+
+		~token_stream(){ close(); }
+
+		token_stream(const token_stream &) = delete;
+		token_stream& operator=(const token_stream &) = delete;
+		//}
+
+		//{Getters
+		/**
+		 * Position on the source of the first byte of the last batch
+		 */
+		unsigned long long get_position() const { return m_position; }
+
+		/**
+		 * Line of the first byte of the last batch, starting from 1
+		 */
+		unsigned long long get_line() const { return m_line; }
+
+		/**
+		 * To know if the source could not be read until the end
+		 */
+		bool failed() const { return m_failed; }
+		//}
+
+		//{Methods
+		/**
+		 * Opens a file to read it, the special name "-" reads from stdin
+		 * @param file_name Path of the file
+		 * @return true on success false otherwise
+		 */
+		bool open(const std::string &file_name);
+
+		/**
+		 * Reads from an already opened file descriptor which is not closed
+		 * @param descriptor The file descriptor
+		 * @param name Name of the source for the errors
+		 */
+		void open(int descriptor, const std::string &name);
+
+		/**
+		 * Stops reading the source, closing it if it was opened by name
+		 */
+		void close();
+
+		/**
+		 * Reads and tokenizes the next batch of lines
+		 * @param lines Set to the lines, they own their buffer so they stay valid after the next call
+		 * but their locations are removed from the source_manager
+		 * @return false at the end of the source
+		 */
+		bool next(tokenized_file &lines);
+		//}
+	};
+};
+
+#endif
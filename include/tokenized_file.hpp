@@ -0,0 +1,180 @@
+#ifndef TOKENIZED_FILE_HPP
+#define TOKENIZED_FILE_HPP
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+#include "source_buffer.hpp"
+#include "source_manager.hpp"
+
+namespace cpp_parser
+{
+    /**
+     * Owner of a tokenized source. Tokens only point into the source buffer
+     * retained by this object, so they stay valid as long as it lives.
+     * Tokens that don't exist on the source (synthesized) get their text
+     * from a separate storage also owned by this object.
+     *
+     * All the tokens are stored on a single contiguous array and lines are
+     * ranges of it described by an index of line starts.
+     */
+	class tokenized_file
+	{
+        private:
+
+	    //{Private properties/members
+		std::shared_ptr<const source_buffer> m_source;  /*< Content referenced by the tokens, null if not owned */
+		source_location m_base;                         /*< Location of the first byte of the content, no_location if it has none */
+		std::deque<std::string> m_synthesized;          /*< Text of tokens not found on the source */
+		std::vector<preprocessor_token> m_tokens;       /*< The tokens of all lines one after the other */
+		std::vector<size_t> m_line_starts;              /*< Index of the first token of each line plus the end of the last one */
+		//}
+
+		public:
+
+        //{Constructor and Destructor
+		tokenized_file(): m_base(no_location), m_line_starts(1, 0){}
+
+		/**
+		 * @param source The buffer that will be referenced by the tokens
+		 * @param base The location given to the buffer by the source_manager, if any
+		 */
+		explicit tokenized_file(const std::shared_ptr<const source_buffer> &source, source_location base = no_location): m_source(source), m_base(base), m_line_starts(1, 0){}
+
+		tokenized_file(tokenized_file &&) = default;
+		tokenized_file& operator=(tokenized_file &&) = default;
+
+		tokenized_file(const tokenized_file &) = delete;
+		tokenized_file& operator=(const tokenized_file &) = delete;
+		//}
+
+		//{Getters
+		/**
+		 * The buffer referenced by the tokens, null when tokenizing non owned characters
+		 */
+		const std::shared_ptr<const source_buffer>& get_source() const { return m_source; }
+
+		/**
+		 * The location of the first byte of the buffer, the tokens are located from it
+		 */
+		source_location get_base() const { return m_base; }
+
+		/**
+		 * The tokens of all the lines
+		 */
+		std::vector<preprocessor_token>& get_tokens(){ return m_tokens; }
+
+		/**
+		 * The tokens of all the lines
+		 */
+		const std::vector<preprocessor_token>& get_tokens() const { return m_tokens; }
+
+		/**
+		 * Amount of lines
+		 */
+		size_t size() const { return m_line_starts.size() - 1; }
+
+		/**
+		 * Tokens of a given line
+		 * @param line Index of the line starting from 0
+		 */
+		token_span operator[](size_t line) const
+		{
+		    const preprocessor_token *tokens = m_tokens.data();
+
+		    return token_span(tokens + m_line_starts[line], tokens + m_line_starts[line + 1]);
+		}
+		//}
+
+		//{Methods
+		/**
+		 * Allocates enough storage for the expected amount of tokens and lines
+		 */
+		void reserve(size_t tokens, size_t lines)
+		{
+		    m_tokens.reserve(tokens);
+		    m_line_starts.reserve(lines + 1);
+		}
+
+		/**
+		 * Removes all the tokens and lines keeping the allocated storage so the
+		 * object can be reused as a scratch buffer
+		 */
+		void clear()
+		{
+		    m_source.reset();
+		    m_base = no_location;
+		    m_synthesized.clear();
+		    m_tokens.clear();
+		    m_line_starts.assign(1, 0);
+		}
+
+		/**
+		 * Frees the storage that was reserved but not used
+		 */
+		void shrink_to_fit()
+		{
+		    m_tokens.shrink_to_fit();
+		    m_line_starts.shrink_to_fit();
+		}
+
+		/**
+		 * Approximate amount of bytes of memory used
+		 */
+		size_t memory_size() const
+		{
+		    return m_tokens.capacity() * sizeof(preprocessor_token) + m_line_starts.capacity() * sizeof(size_t);
+		}
+
+		/**
+		 * Removes the lines that follow the given amount of them
+		 * @param lines Amount of lines kept
+		 */
+		void resize(size_t lines)
+		{
+		    m_tokens.resize(m_line_starts[lines]);
+		    m_line_starts.resize(lines + 1);
+		}
+
+		/**
+		 * Moves the locations of the tokens to a new base, for a content tokenized
+		 * before knowing the location that the source_manager gives it
+		 * @param base The new location of the first byte, no_location to leave the tokens without one
+		 */
+		void rebase(source_location base)
+		{
+		    for(preprocessor_token &token : m_tokens)
+		    {
+		        if(token.location != no_location)
+		        {
+		            token.location = base == no_location ? no_location : token.location - m_base + base;
+		        }
+		    }
+
+		    m_base = base;
+		}
+
+		/**
+		 * Marks the tokens added since the last call as a new line
+		 */
+		void end_line(){ m_line_starts.push_back(m_tokens.size()); }
+
+		/**
+		 * Stores the text of a token that is not part of the source
+		 * @param text The text of the token
+		 * @return View of the stored text that remains valid while this object exists
+		 */
+		std::string_view synthesize(const std::string &text)
+		{
+		    m_synthesized.push_back(text);
+
+		    return m_synthesized.back();
+		}
+		//}
+	};
+};
+
+#endif
@@ -1,7 +1,10 @@
 #ifndef TYPES_HPP
 #define TYPES_HPP
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cpp_parser
@@ -48,8 +51,211 @@ namespace cpp_parser
 	    multi_comment,          // /* */
 	    number,                 // 0-9
 	    new_line,               // \n
+	    data_run,               // 0x12, 0x34, ... a list of numbers copied as it is
 	    other                   // Anything else
 	};
+
+    /**
+     * To identify each c/c++ keyword, identifiers that are not keywords are no_keyword
+     */
+	enum keyword_type
+	{
+	    no_keyword,
+	    keyword_alignas,
+	    keyword_alignof,
+	    keyword_and,
+	    keyword_and_eq,
+	    keyword_asm,
+	    keyword_auto,
+	    keyword_bitand,
+	    keyword_bitor,
+	    keyword_bool,
+	    keyword_break,
+	    keyword_case,
+	    keyword_catch,
+	    keyword_char,
+	    keyword_char16_t,
+	    keyword_char32_t,
+	    keyword_char8_t,
+	    keyword_class,
+	    keyword_co_await,
+	    keyword_co_return,
+	    keyword_co_yield,
+	    keyword_compl,
+	    keyword_concept,
+	    keyword_const,
+	    keyword_const_cast,
+	    keyword_consteval,
+	    keyword_constexpr,
+	    keyword_constinit,
+	    keyword_continue,
+	    keyword_decltype,
+	    keyword_default,
+	    keyword_delete,
+	    keyword_do,
+	    keyword_double,
+	    keyword_dynamic_cast,
+	    keyword_else,
+	    keyword_enum,
+	    keyword_explicit,
+	    keyword_export,
+	    keyword_extern,
+	    keyword_false,
+	    keyword_float,
+	    keyword_for,
+	    keyword_friend,
+	    keyword_goto,
+	    keyword_if,
+	    keyword_inline,
+	    keyword_int,
+	    keyword_long,
+	    keyword_mutable,
+	    keyword_namespace,
+	    keyword_new,
+	    keyword_noexcept,
+	    keyword_not,
+	    keyword_not_eq,
+	    keyword_nullptr,
+	    keyword_operator,
+	    keyword_or,
+	    keyword_or_eq,
+	    keyword_private,
+	    keyword_protected,
+	    keyword_public,
+	    keyword_register,
+	    keyword_reinterpret_cast,
+	    keyword_requires,
+	    keyword_return,
+	    keyword_short,
+	    keyword_signed,
+	    keyword_sizeof,
+	    keyword_static,
+	    keyword_static_assert,
+	    keyword_static_cast,
+	    keyword_struct,
+	    keyword_switch,
+	    keyword_template,
+	    keyword_this,
+	    keyword_thread_local,
+	    keyword_throw,
+	    keyword_true,
+	    keyword_try,
+	    keyword_typedef,
+	    keyword_typeid,
+	    keyword_typename,
+	    keyword_union,
+	    keyword_unsigned,
+	    keyword_using,
+	    keyword_virtual,
+	    keyword_void,
+	    keyword_volatile,
+	    keyword_wchar_t,
+	    keyword_while,
+	    keyword_xor,
+	    keyword_xor_eq,
+	    keyword_count
+	};
+
+    /**
+     * To identify each preprocessor directive (the identifier after #)
+     */
+	enum directive_type
+	{
+	    no_directive,           // Unknown or empty (null) directive
+	    directive_define,
+	    directive_undef,
+	    directive_include,
+	    directive_include_next,
+	    directive_import,
+	    directive_if,
+	    directive_ifdef,
+	    directive_ifndef,
+	    directive_elif,
+	    directive_elifdef,
+	    directive_elifndef,
+	    directive_else,
+	    directive_endif,
+	    directive_error,
+	    directive_warning,
+	    directive_pragma,
+	    directive_line,
+	    directive_ident,
+	    directive_count
+	};
+
+    /**
+     * To identify each c/c++ punctuator (operators and separators)
+     */
+	enum punctuator_type
+	{
+	    no_punctuator,
+	    punctuator_left_brace,            // {
+	    punctuator_right_brace,           // }
+	    punctuator_left_bracket,          // [
+	    punctuator_right_bracket,         // ]
+	    punctuator_left_parenthesis,      // (
+	    punctuator_right_parenthesis,     // )
+	    punctuator_semicolon,             // ;
+	    punctuator_colon,                 // :
+	    punctuator_ellipsis,              // ...
+	    punctuator_question,              // ?
+	    punctuator_scope,                 // ::
+	    punctuator_dot,                   // .
+	    punctuator_dot_star,              // .*
+	    punctuator_arrow,                 // ->
+	    punctuator_arrow_star,            // ->*
+	    punctuator_tilde,                 // ~
+	    punctuator_exclaim,               // !
+	    punctuator_plus,                  // +
+	    punctuator_minus,                 // -
+	    punctuator_star,                  // *
+	    punctuator_slash,                 // /
+	    punctuator_percent,               // %
+	    punctuator_caret,                 // ^
+	    punctuator_ampersand,             // &
+	    punctuator_pipe,                  // |
+	    punctuator_equal,                 // =
+	    punctuator_plus_equal,            // +=
+	    punctuator_minus_equal,           // -=
+	    punctuator_star_equal,            // *=
+	    punctuator_slash_equal,           // /=
+	    punctuator_percent_equal,         // %=
+	    punctuator_caret_equal,           // ^=
+	    punctuator_ampersand_equal,       // &=
+	    punctuator_pipe_equal,            // |=
+	    punctuator_equal_equal,           // ==
+	    punctuator_exclaim_equal,         // !=
+	    punctuator_less,                  // <
+	    punctuator_greater,               // >
+	    punctuator_less_equal,            // <=
+	    punctuator_greater_equal,         // >=
+	    punctuator_spaceship,             // <=>
+	    punctuator_ampersand_ampersand,   // &&
+	    punctuator_pipe_pipe,             // ||
+	    punctuator_less_less,             // <<
+	    punctuator_greater_greater,       // >>
+	    punctuator_less_less_equal,       // <<=
+	    punctuator_greater_greater_equal, // >>=
+	    punctuator_plus_plus,             // ++
+	    punctuator_minus_minus,           // --
+	    punctuator_comma,                 // ,
+	    punctuator_hash,                  // #
+	    punctuator_hash_hash,             // ##
+	    punctuator_count
+	};
+	//}
+
+    //{Types
+    /**
+     * Small integer that identifies an interned spelling (see atom_table),
+     * the atoms below keyword_count are the keyword_type of the spelling.
+     */
+	typedef unsigned int atom;
+
+    /**
+     * Position of a byte of the sources on the location space of the source_manager
+     */
+	typedef unsigned long long source_location;
 	//}
 
     //{Data structures
@@ -63,30 +269,115 @@ namespace cpp_parser
 		std::string file_name;  /*< name of the include file */
 	};
 
+    /**
+     * Identifies a file by its device and inode, whatever path was used to reach it
+     */
+    struct file_identity
+    {
+        unsigned long long device;
+        unsigned long long inode;
+
+        bool operator==(const file_identity &other) const { return device == other.device && inode == other.inode; }
+    };
+
+    /**
+     * Identity of a file plus what changes when its content does
+     */
+    struct file_stamp
+    {
+        file_identity identity;
+        long long modified;     /*< Modification time in nanoseconds */
+        unsigned long long size;
+    };
+
+    /**
+     * To use file_identity as the key of unordered containers
+     */
+    struct file_identity_hash
+    {
+        size_t operator()(const file_identity &identity) const { return std::hash<unsigned long long>()(identity.inode * 31 + identity.device); }
+    };
+
+	/**
+     * To hold data about a token. The token text is not owned, it points
+     * into the source buffer kept alive by the tokenized_file that produced it.
+     */
+    struct preprocessor_token
+    {
+        std::string_view token;     /*< token string */
+        source_location location;   /*< Where the token starts, its line and column are found by the source_manager */
+        token_type type;            /*< type of token */
+        unsigned int id;            /*< atom for identifiers, punctuator_type for punctuators, the decoded value
+                                        of number and character literals (see preprocessor_tokenizer::get_literal), 0 otherwise */
+    };
+
+    /**
+     * Value of an integer or character literal as seen by #if expressions, where all
+     * the signed types behave as intmax_t and the unsigned ones as uintmax_t
+     */
+    struct integer_literal
+    {
+        std::uintmax_t value;   /*< Bits of the value, read as intmax_t when signed */
+        bool is_unsigned;       /*< true with the u suffix, for values that don't fit intmax_t and unsigned character types */
+    };
+
+    /**
+     * Non owning range of contiguous tokens, for example the tokens of a line
+     */
+    class token_span
+    {
+        private:
+        const preprocessor_token *m_begin;
+        const preprocessor_token *m_end;
+
+        public:
+        token_span(): m_begin(0), m_end(0){}
+
+        token_span(const preprocessor_token *begin, const preprocessor_token *end): m_begin(begin), m_end(end){}
+
+        const preprocessor_token* begin() const { return m_begin; }
+        const preprocessor_token* end() const { return m_end; }
+
+        size_t size() const { return m_end - m_begin; }
+        bool empty() const { return m_begin == m_end; }
+
+        const preprocessor_token& operator[](size_t index) const { return m_begin[index]; }
+        const preprocessor_token& front() const { return *m_begin; }
+        const preprocessor_token& back() const { return *(m_end - 1); }
+
+        /**
+         * The tokens after skipping the given amount of them
+         */
+        token_span subspan(size_t offset) const { return token_span(m_begin + offset, m_end); }
+    };
+
+    /**
+     * A token of the replacement list of a macro, classified when the macro is defined
+     */
+    struct replacement_token
+    {
+        preprocessor_token token;   /*< The token, its text is owned by the macro_table */
+        int parameter;              /*< Index of the parameter it names, -1 if it isn't a parameter */
+        bool leading_space;         /*< true if there was white space before the token on the definition */
+    };
+
     /**
      * To hold data of a #define statement
      */
 	struct define
 	{
-	    std::string file;                       /*< Name of the header file where #define was found */
+	    atom file;                              /*< Atom of the name of the header file where #define was found */
 		define_type type;                       /*< Type of define */
 		std::string name;                       /*< Name of macro */
 		std::string value;                      /*< Value of the definition */
+		atom name_atom;                         /*< Interned name of the macro, set when stored on a macro_table */
 		unsigned int line;                      /*< Line position where the definition was found in the file */
 		unsigned int column;                    /*< Column position where the definition starts */
-		std::vector<std::string> parameters;    /*< Definition parameters in case of macro function */
+		std::vector<std::string> parameters;    /*< Definition parameters in case of macro function, __VA_ARGS__ for ... */
+		bool variadic;                          /*< true if the last parameter takes the remaining arguments */
+		const replacement_token *replacement;   /*< Pre-lexed replacement list, owned by the macro_table that stores the define */
+		unsigned int replacement_size;          /*< Amount of tokens of the replacement list */
 	};
-
-	/**
-     * To hold data about a token
-     */
-    struct preprocessor_token
-    {
-        unsigned int column;    /*< column position */
-        unsigned int line;      /*< line position */
-        std::string token;      /*< token string */
-        token_type type;        /*< type of token */
-    };
 	//}
 };
 
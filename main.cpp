@@ -1,9 +1,12 @@
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <iostream>
+#include <unistd.h>
 #include "misc.hpp"
 #include "types.hpp"
 #include "preprocessor.hpp"
+#include "character_scanner.hpp"
 
 using namespace std;
 using namespace cpp_parser;
@@ -13,6 +16,7 @@ int main(int argc, char** argv)
     string argument;
     string file = "";
     string action = "";
+    long long stream_size = -1;
 
     vector<string> global_includes;
     vector<string> local_includes;
@@ -38,6 +42,14 @@ int main(int argc, char** argv)
             {
                 action = "D";
             }
+            else if(argument == "-ss" || argument == "--stream_size")
+            {
+                action = "ss";
+            }
+            else if(argument == "-ns" || argument == "--no_simd")
+            {
+                character_scanner::set_level(scanner_scalar);
+            }
             else if(argument == "-v" || argument == "--version")
             {
                 cout << "cpp_parser " << version();
@@ -52,6 +64,10 @@ int main(int argc, char** argv)
                 "Add path to search for header files enclosed in <>, example #include <string>\n"
                 "\t-Il, --include_local\t\t"
                 "Add path to search for header files enclosed in \"\", example #include \"file.h\"\n"
+                "\t-ss, --stream_size\t\t"
+                "Files bigger than this amount of bytes are read in batches, 0 to never do it.\n"
+                "\t-ns, --no_simd\t\t"
+                "Tokenize without the vectorized scanners.\n"
                 "\t-v, --version\t\t"
                 "Displays the cpp_parser libary version.\n"
                 "\t-help, --help\t\t"
@@ -72,6 +88,10 @@ int main(int argc, char** argv)
                 else if(action == "D")
                 {
 
+                }
+                else if(action == "ss")
+                {
+                    stream_size = atoll(argument.c_str());
                 }
                 else
                 {
@@ -104,11 +124,20 @@ int main(int argc, char** argv)
 	parser.set_local_includes(local_includes);
 	parser.set_global_includes(global_includes);
 
-    cout << parser.parse_file(file);
+	if(stream_size >= 0)
+	{
+	    parser.set_stream_size(stream_size);
+	}
+
+    //The output is written as it is produced
+    fd_sink output(STDOUT_FILENO);
+
+    parser.parse_file(file, output);
+    output.flush();
 
 	/*for(unsigned int i = 0; i<parser.get_local_defines().size(); i++)
 	{
-	    cout << "File: " << parser.get_local_defines()[i].file << "\n";
+	    cout << "File: " << cpp_parser::atom_table::get_spelling(parser.get_local_defines()[i].file) << "\n";
 	    cout << "Name: " << parser.get_local_defines()[i].name << "\n";
 	    cout << "Value: " << parser.get_local_defines()[i].value << "\n";
 	    cout << "Line: " << parser.get_local_defines()[i].line << "\n";
@@ -0,0 +1,142 @@
+#include <mutex>
+#include <cstring>
+#include "atom_table.hpp"
+#include "preprocessor_tokenizer.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        /**
+         * Entry of the per thread cache of recently interned spellings
+         */
+        struct cached_atom
+        {
+            const char *spelling;   /*< Points to the table storage, null for empty entries */
+            size_t size;
+            atom value;
+        };
+
+        const size_t cache_size = 4096;
+
+        /**
+         * Most identifiers repeat a lot, the cache avoids taking the lock for them
+         */
+        thread_local cached_atom atom_cache[cache_size];
+
+        inline size_t cache_slot(string_view spelling)
+        {
+            unsigned int hash = 2166136261u;
+
+            for(size_t i = 0; i < spelling.size(); i++)
+            {
+                hash ^= static_cast<unsigned char>(spelling[i]);
+                hash *= 16777619u;
+            }
+
+            return hash & (cache_size - 1);
+        }
+    }
+
+	atom_table::atom_table()
+	{
+	    m_spellings.push_back(string_view()); //no_atom
+
+	    //Keywords go first so their atom is also their keyword_type
+	    for(unsigned int keyword = no_keyword + 1; keyword < keyword_count; keyword++)
+	    {
+	        add(preprocessor_tokenizer::get_keyword_name(static_cast<keyword_type>(keyword)));
+	    }
+	}
+
+	atom_table& atom_table::instance()
+	{
+	    static atom_table table;
+
+	    return table;
+	}
+
+	atom atom_table::add(string_view spelling)
+	{
+	    m_storage.push_back(string(spelling));
+
+	    atom value = m_spellings.size();
+
+	    m_spellings.push_back(m_storage.back());
+	    m_atoms[m_storage.back()] = value;
+
+	    return value;
+	}
+
+	atom atom_table::intern(string_view spelling)
+	{
+	    cached_atom &cached = atom_cache[cache_slot(spelling)];
+
+	    if(cached.spelling && cached.size == spelling.size() && memcmp(cached.spelling, spelling.data(), cached.size) == 0)
+	    {
+	        return cached.value;
+	    }
+
+	    atom_table &table = instance();
+	    string_view stored;
+	    atom value;
+
+	    {
+	        shared_lock<shared_mutex> lock(table.m_mutex);
+
+	        unordered_map<string_view, atom>::const_iterator found = table.m_atoms.find(spelling);
+
+	        if(found != table.m_atoms.end())
+	        {
+	            stored = found->first;
+	            value = found->second;
+	        }
+	    }
+
+	    if(!stored.data())
+	    {
+	        unique_lock<shared_mutex> lock(table.m_mutex);
+
+	        //Another thread could have added it while the lock was released
+	        unordered_map<string_view, atom>::const_iterator found = table.m_atoms.find(spelling);
+
+	        value = found != table.m_atoms.end() ? found->second : table.add(spelling);
+	        stored = table.m_spellings[value];
+	    }
+
+	    //The stored spellings are never freed so the cache can point to them
+	    cached.spelling = stored.data();
+	    cached.size = stored.size();
+	    cached.value = value;
+
+	    return value;
+	}
+
+	atom atom_table::find(string_view spelling)
+	{
+	    atom_table &table = instance();
+	    shared_lock<shared_mutex> lock(table.m_mutex);
+
+	    unordered_map<string_view, atom>::const_iterator found = table.m_atoms.find(spelling);
+
+	    return found != table.m_atoms.end() ? found->second : no_atom;
+	}
+
+	string_view atom_table::get_spelling(atom value)
+	{
+	    atom_table &table = instance();
+	    shared_lock<shared_mutex> lock(table.m_mutex);
+
+	    return value < table.m_spellings.size() ? table.m_spellings[value] : string_view();
+	}
+
+	size_t atom_table::size()
+	{
+	    atom_table &table = instance();
+	    shared_lock<shared_mutex> lock(table.m_mutex);
+
+	    return table.m_spellings.size();
+	}
+}
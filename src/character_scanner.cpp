@@ -0,0 +1,600 @@
+#include <cstring>
+#include "character_scanner.hpp"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <immintrin.h>
+#define CPP_PARSER_X86_SIMD
+#endif
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        //{Scalar versions, also used for the bytes left after the vectorized loops
+        inline bool is_blank(unsigned char byte)
+        {
+            return byte == ' ' || byte == '\t' || byte == '\v' || byte == '\f' || byte == '\r';
+        }
+
+        inline bool is_identifier(unsigned char byte)
+        {
+            return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') || byte == '_' || byte == '$';
+        }
+
+        size_t skip_blanks_scalar(const char *characters, size_t position, size_t size)
+        {
+            while(position < size && is_blank(characters[position]))
+            {
+                position++;
+            }
+
+            return position;
+        }
+
+        size_t skip_identifier_scalar(const char *characters, size_t position, size_t size)
+        {
+            while(position < size && is_identifier(characters[position]))
+            {
+                position++;
+            }
+
+            return position;
+        }
+
+        size_t find_string_special_scalar(const char *characters, size_t position, size_t size, char enclosure)
+        {
+            while(position < size && characters[position] != enclosure && characters[position] != '\\' && characters[position] != '\n')
+            {
+                position++;
+            }
+
+            return position;
+        }
+
+        size_t find_comment_end_scalar(const char *characters, size_t position, size_t size)
+        {
+            while(position < size && !(characters[position] == '*' && position + 1 < size && characters[position + 1] == '/'))
+            {
+                position++;
+            }
+
+            return position;
+        }
+
+        size_t find_line_special_scalar(const char *characters, size_t position, size_t size)
+        {
+            while(position < size)
+            {
+                char byte = characters[position];
+
+                if(byte == '\n' || byte == '/' || byte == '"' || byte == '\'' || byte == '\\')
+                {
+                    break;
+                }
+
+                position++;
+            }
+
+            return position;
+        }
+
+        void find_line_starts_scalar(const char *characters, size_t position, size_t size, vector<unsigned int> &starts)
+        {
+            while(position < size)
+            {
+                const void *line_end = memchr(characters + position, '\n', size - position);
+
+                if(!line_end)
+                {
+                    break;
+                }
+
+                position = static_cast<const char*>(line_end) - characters + 1;
+                starts.push_back(position);
+            }
+        }
+
+        size_t count_new_lines_scalar(const char *characters, size_t position, size_t size)
+        {
+            size_t new_lines = 0;
+
+            for(; position < size; position++)
+            {
+                new_lines += characters[position] == '\n';
+            }
+
+            return new_lines;
+        }
+        //}
+
+#ifdef CPP_PARSER_X86_SIMD
+        //{Bit helpers for the masks returned by movemask
+        inline unsigned int lowest_bit(unsigned int mask)
+        {
+            return __builtin_ctz(mask);
+        }
+
+        /**
+         * Appends the position after each new line of a mask
+         */
+        inline void add_line_starts(unsigned int new_line_mask, size_t base, vector<unsigned int> &starts)
+        {
+            while(new_line_mask)
+            {
+                starts.push_back(base + lowest_bit(new_line_mask) + 1);
+                new_line_mask &= new_line_mask - 1;
+            }
+        }
+        //}
+
+        //{SSE2 versions, 16 bytes at a time
+        /**
+         * Bytes of value between low and high inclusive (unsigned comparison)
+         */
+        inline __m128i in_range_sse2(__m128i bytes, char low, char high)
+        {
+            __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8(low));
+
+            return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(high - low)), shifted);
+        }
+
+        size_t skip_blanks_sse2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                //\t \n \v \f \r are 9 to 13, but a new line is not a blank
+                __m128i blanks = _mm_or_si128(
+                    _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                    _mm_andnot_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')), in_range_sse2(bytes, '\t', '\r'))
+                );
+
+                unsigned int mask = ~_mm_movemask_epi8(blanks) & 0xFFFF;
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 16;
+            }
+
+            return skip_blanks_scalar(characters, position, size);
+        }
+
+        size_t skip_identifier_sse2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                //Setting the 0x20 bit turns upper case letters into lower case ones
+                __m128i letters = in_range_sse2(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+                __m128i digits = in_range_sse2(bytes, '0', '9');
+                __m128i others = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('$')));
+
+                unsigned int mask = ~_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), others)) & 0xFFFF;
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 16;
+            }
+
+            return skip_identifier_scalar(characters, position, size);
+        }
+
+        size_t find_string_special_sse2(const char *characters, size_t position, size_t size, char enclosure)
+        {
+            __m128i enclosures = _mm_set1_epi8(enclosure);
+            __m128i escapes = _mm_set1_epi8('\\');
+            __m128i new_lines = _mm_set1_epi8('\n');
+
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                unsigned int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, enclosures), _mm_cmpeq_epi8(bytes, escapes)),
+                    _mm_cmpeq_epi8(bytes, new_lines)));
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 16;
+            }
+
+            return find_string_special_scalar(characters, position, size, enclosure);
+        }
+
+        size_t find_comment_end_sse2(const char *characters, size_t position, size_t size)
+        {
+            //The second load is one byte ahead to check for the / after each *
+            while(position + 17 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+                __m128i next_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position + 1));
+
+                unsigned int end_mask = _mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi8(bytes, _mm_set1_epi8('*')),
+                    _mm_cmpeq_epi8(next_bytes, _mm_set1_epi8('/'))
+                ));
+
+                if(end_mask)
+                {
+                    return position + lowest_bit(end_mask);
+                }
+
+                position += 16;
+            }
+
+            return find_comment_end_scalar(characters, position, size);
+        }
+
+        size_t find_line_special_sse2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                __m128i specials = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('/'))),
+                    _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\''))),
+                        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))
+                    )
+                );
+
+                unsigned int mask = _mm_movemask_epi8(specials);
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 16;
+            }
+
+            return find_line_special_scalar(characters, position, size);
+        }
+
+        void find_line_starts_sse2(const char *characters, size_t position, size_t size, vector<unsigned int> &starts)
+        {
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                add_line_starts(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))), position, starts);
+
+                position += 16;
+            }
+
+            find_line_starts_scalar(characters, position, size, starts);
+        }
+
+        size_t count_new_lines_sse2(const char *characters, size_t position, size_t size)
+        {
+            size_t new_lines = 0;
+
+            while(position + 16 <= size)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(characters + position));
+
+                new_lines += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))));
+
+                position += 16;
+            }
+
+            return new_lines + count_new_lines_scalar(characters, position, size);
+        }
+        //}
+
+        //{AVX2 versions, 32 bytes at a time, only called if the processor supports them
+        __attribute__((target("avx2")))
+        inline __m256i in_range_avx2(__m256i bytes, char low, char high)
+        {
+            __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(high - low)), shifted);
+        }
+
+        __attribute__((target("avx2")))
+        size_t skip_blanks_avx2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                __m256i blanks = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                    _mm256_andnot_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')), in_range_avx2(bytes, '\t', '\r'))
+                );
+
+                unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(blanks));
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 32;
+            }
+
+            return skip_blanks_sse2(characters, position, size);
+        }
+
+        __attribute__((target("avx2")))
+        size_t skip_identifier_avx2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                __m256i letters = in_range_avx2(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z');
+                __m256i digits = in_range_avx2(bytes, '0', '9');
+                __m256i others = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('$')));
+
+                unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letters, digits), others)));
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 32;
+            }
+
+            return skip_identifier_sse2(characters, position, size);
+        }
+
+        __attribute__((target("avx2")))
+        size_t find_string_special_avx2(const char *characters, size_t position, size_t size, char enclosure)
+        {
+            __m256i enclosures = _mm256_set1_epi8(enclosure);
+            __m256i escapes = _mm256_set1_epi8('\\');
+            __m256i new_lines = _mm256_set1_epi8('\n');
+
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                unsigned int mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, enclosures), _mm256_cmpeq_epi8(bytes, escapes)),
+                    _mm256_cmpeq_epi8(bytes, new_lines)));
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 32;
+            }
+
+            return find_string_special_sse2(characters, position, size, enclosure);
+        }
+
+        __attribute__((target("avx2")))
+        size_t find_comment_end_avx2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 33 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+                __m256i next_bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position + 1));
+
+                unsigned int end_mask = _mm256_movemask_epi8(_mm256_and_si256(
+                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('*')),
+                    _mm256_cmpeq_epi8(next_bytes, _mm256_set1_epi8('/'))
+                ));
+
+                if(end_mask)
+                {
+                    return position + lowest_bit(end_mask);
+                }
+
+                position += 32;
+            }
+
+            return find_comment_end_sse2(characters, position, size);
+        }
+
+        __attribute__((target("avx2")))
+        size_t find_line_special_avx2(const char *characters, size_t position, size_t size)
+        {
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                __m256i specials = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('/'))),
+                    _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\''))),
+                        _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))
+                    )
+                );
+
+                unsigned int mask = _mm256_movemask_epi8(specials);
+
+                if(mask)
+                {
+                    return position + lowest_bit(mask);
+                }
+
+                position += 32;
+            }
+
+            return find_line_special_sse2(characters, position, size);
+        }
+        __attribute__((target("avx2")))
+        void find_line_starts_avx2(const char *characters, size_t position, size_t size, vector<unsigned int> &starts)
+        {
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                add_line_starts(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))), position, starts);
+
+                position += 32;
+            }
+
+            find_line_starts_sse2(characters, position, size, starts);
+        }
+
+        __attribute__((target("avx2")))
+        size_t count_new_lines_avx2(const char *characters, size_t position, size_t size)
+        {
+            size_t new_lines = 0;
+
+            while(position + 32 <= size)
+            {
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(characters + position));
+
+                new_lines += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'))));
+
+                position += 32;
+            }
+
+            return new_lines + count_new_lines_sse2(characters, position, size);
+        }
+        //}
+#endif
+    }
+
+	scanner_level character_scanner::m_level = character_scanner::get_supported_level();
+
+	scanner_level character_scanner::get_supported_level()
+	{
+#ifdef CPP_PARSER_X86_SIMD
+	    //Needed since this may run before the constructor that initializes the cpu features
+	    __builtin_cpu_init();
+
+	    if(__builtin_cpu_supports("avx2"))
+	    {
+	        return scanner_avx2;
+	    }
+
+	    return scanner_sse2;
+#else
+	    return scanner_scalar;
+#endif
+	}
+
+	void character_scanner::set_level(scanner_level level)
+	{
+	    scanner_level supported = get_supported_level();
+
+	    m_level = level > supported ? supported : level;
+	}
+
+	size_t character_scanner::skip_blanks(const char *characters, size_t position, size_t size)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return skip_blanks_avx2(characters, position, size);
+	        case scanner_sse2:
+	            return skip_blanks_sse2(characters, position, size);
+#endif
+	        default:
+	            return skip_blanks_scalar(characters, position, size);
+	    }
+	}
+
+	size_t character_scanner::skip_identifier(const char *characters, size_t position, size_t size)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return skip_identifier_avx2(characters, position, size);
+	        case scanner_sse2:
+	            return skip_identifier_sse2(characters, position, size);
+#endif
+	        default:
+	            return skip_identifier_scalar(characters, position, size);
+	    }
+	}
+
+	size_t character_scanner::find_string_special(const char *characters, size_t position, size_t size, char enclosure)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return find_string_special_avx2(characters, position, size, enclosure);
+	        case scanner_sse2:
+	            return find_string_special_sse2(characters, position, size, enclosure);
+#endif
+	        default:
+	            return find_string_special_scalar(characters, position, size, enclosure);
+	    }
+	}
+
+	size_t character_scanner::find_comment_end(const char *characters, size_t position, size_t size)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return find_comment_end_avx2(characters, position, size);
+	        case scanner_sse2:
+	            return find_comment_end_sse2(characters, position, size);
+#endif
+	        default:
+	            return find_comment_end_scalar(characters, position, size);
+	    }
+	}
+
+	size_t character_scanner::find_line_special(const char *characters, size_t position, size_t size)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return find_line_special_avx2(characters, position, size);
+	        case scanner_sse2:
+	            return find_line_special_sse2(characters, position, size);
+#endif
+	        default:
+	            return find_line_special_scalar(characters, position, size);
+	    }
+	}
+
+	void character_scanner::find_line_starts(const char *characters, size_t size, vector<unsigned int> &starts)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            find_line_starts_avx2(characters, 0, size, starts);
+	            break;
+	        case scanner_sse2:
+	            find_line_starts_sse2(characters, 0, size, starts);
+	            break;
+#endif
+	        default:
+	            find_line_starts_scalar(characters, 0, size, starts);
+	            break;
+	    }
+	}
+
+	size_t character_scanner::count_new_lines(const char *characters, size_t size)
+	{
+	    switch(m_level)
+	    {
+#ifdef CPP_PARSER_X86_SIMD
+	        case scanner_avx2:
+	            return count_new_lines_avx2(characters, 0, size);
+	        case scanner_sse2:
+	            return count_new_lines_sse2(characters, 0, size);
+#endif
+	        default:
+	            return count_new_lines_scalar(characters, 0, size);
+	    }
+	}
+}
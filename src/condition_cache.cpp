@@ -0,0 +1,549 @@
+#include <mutex>
+#include "atom_table.hpp"
+#include "condition_cache.hpp"
+#include "constexpr.hpp"
+#include "preprocessor_tokenizer.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        const unsigned int max_stack_size = 64;
+        const unsigned int max_macro_depth = 16;
+
+        /**
+         * Checks if a token is only white space for an expression, including the \\ of continued lines
+         */
+        inline bool is_blank(const preprocessor_token &token)
+        {
+            return token.type == comment || token.type == multi_comment || token.type == new_line || token.token == "\\";
+        }
+
+        /**
+         * Checks if a token is a given punctuator
+         */
+        inline bool is_punctuator(const preprocessor_token *token, punctuator_type kind)
+        {
+            return token && token->type != identifier && token->type != number && token->type != strings && token->id == static_cast<unsigned int>(kind);
+        }
+
+        /**
+         * Precedence of the binary operators, 0 for the other tokens
+         */
+        unsigned int binary_precedence(const preprocessor_token *token, TokenType &type)
+        {
+            if(!token || token->type == identifier || token->type == number || token->type == strings)
+            {
+                return 0;
+            }
+
+            switch(token->id)
+            {
+                case punctuator_star: type = ttTimes; return 10;
+                case punctuator_slash: type = ttDivide; return 10;
+                case punctuator_percent: type = ttModulo; return 10;
+                case punctuator_plus: type = ttPlus; return 9;
+                case punctuator_minus: type = ttMinus; return 9;
+                case punctuator_less_less: type = ttLShift; return 8;
+                case punctuator_greater_greater: type = ttRShift; return 8;
+                case punctuator_less: type = ttLess; return 7;
+                case punctuator_greater: type = ttGreater; return 7;
+                case punctuator_less_equal: type = ttLessEqual; return 7;
+                case punctuator_greater_equal: type = ttGreaterEqual; return 7;
+                case punctuator_equal_equal: type = ttEqual; return 6;
+                case punctuator_exclaim_equal: type = ttNotEqual; return 6;
+                case punctuator_ampersand: type = ttBitAnd; return 5;
+                case punctuator_caret: type = ttBitXOr; return 4;
+                case punctuator_pipe: type = ttBitOr; return 3;
+                case punctuator_ampersand_ampersand: type = ttAnd; return 2;
+                case punctuator_pipe_pipe: type = ttOr; return 1;
+                default: return 0;
+            }
+        }
+
+        /**
+         * Builds the code of an expression by precedence climbing
+         */
+        class condition_compiler
+        {
+            private:
+            vector<const preprocessor_token*> m_tokens; /*< The tokens without white space */
+            size_t m_position;
+            compiled_condition &m_condition;
+            unsigned int m_depth;                       /*< Values on the stack at the current point */
+            bool m_failed;
+
+            const preprocessor_token* peek(size_t ahead = 0) const
+            {
+                return m_position + ahead < m_tokens.size() ? m_tokens[m_position + ahead] : 0;
+            }
+
+            size_t emit(condition_opcode opcode, uintmax_t operand, int stack_change)
+            {
+                condition_instruction instruction = { opcode, operand };
+
+                m_condition.code.push_back(instruction);
+                m_depth += stack_change;
+
+                if(m_depth > m_condition.stack_size)
+                {
+                    m_condition.stack_size = m_depth;
+                }
+
+                return m_condition.code.size() - 1;
+            }
+
+            void patch(size_t jump)
+            {
+                m_condition.code[jump].operand = m_condition.code.size();
+            }
+
+            void expression()
+            {
+                conditional();
+
+                while(!m_failed && is_punctuator(peek(), punctuator_comma))
+                {
+                    m_position++;
+                    emit(opcode_pop, 0, -1);
+                    conditional();
+                }
+            }
+
+            void conditional()
+            {
+                binary(1);
+
+                if(m_failed || !is_punctuator(peek(), punctuator_question))
+                {
+                    return;
+                }
+
+                m_position++;
+                expression();
+
+                if(m_failed || !is_punctuator(peek(), punctuator_colon))
+                {
+                    m_failed = true;
+                    return;
+                }
+
+                m_position++;
+                conditional();
+                emit(opcode_select, 0, -2);
+            }
+
+            void binary(unsigned int minimum_precedence)
+            {
+                unary();
+
+                TokenType type = ttEndOfTokens;
+                unsigned int precedence;
+
+                while(!m_failed && (precedence = binary_precedence(peek(), type)) >= minimum_precedence && precedence > 0)
+                {
+                    m_position++;
+
+                    if(type == ttAnd || type == ttOr)
+                    {
+                        //The right side is jumped over when the left one decides
+                        size_t jump = emit(type == ttAnd ? opcode_and_jump : opcode_or_jump, 0, -1);
+
+                        binary(precedence + 1);
+                        emit(opcode_to_bool, 0, 0);
+                        patch(jump);
+                    }
+                    else
+                    {
+                        binary(precedence + 1);
+                        emit(opcode_binary, type, -1);
+                    }
+                }
+            }
+
+            void unary()
+            {
+                const preprocessor_token *token = peek();
+
+                if(is_punctuator(token, punctuator_plus))
+                {
+                    m_position++;
+                    unary();
+                }
+                else if(is_punctuator(token, punctuator_minus))
+                {
+                    m_position++;
+                    unary();
+                    emit(opcode_unary, ttMinus, 0);
+                }
+                else if(is_punctuator(token, punctuator_exclaim))
+                {
+                    m_position++;
+                    unary();
+                    emit(opcode_unary, ttNot, 0);
+                }
+                else if(is_punctuator(token, punctuator_tilde))
+                {
+                    m_position++;
+                    unary();
+                    emit(opcode_unary, ttBitNeg, 0);
+                }
+                else
+                {
+                    primary();
+                }
+            }
+
+            void primary()
+            {
+                static const atom defined_atom = atom_table::intern("defined");
+
+                const preprocessor_token *token = peek();
+
+                if(!token || m_depth >= max_stack_size)
+                {
+                    m_failed = true;
+                }
+                else if(is_punctuator(token, punctuator_left_parenthesis))
+                {
+                    m_position++;
+                    expression();
+
+                    if(is_punctuator(peek(), punctuator_right_parenthesis))
+                    {
+                        m_position++;
+                    }
+                    else
+                    {
+                        m_failed = true;
+                    }
+                }
+                else if(token->type == number || (token->type == strings && token->token.back() == '\''))
+                {
+                    integer_literal value;
+
+                    m_position++;
+
+                    if(preprocessor_tokenizer::get_literal(*token, value))
+                    {
+                        emit(value.is_unsigned ? opcode_push_unsigned : opcode_push, value.value, 1);
+                    }
+                    else
+                    {
+                        m_failed = true;
+                    }
+                }
+                else if(token->type == identifier && token->id == defined_atom)
+                {
+                    //defined X or defined(X)
+                    bool parenthesis = is_punctuator(peek(1), punctuator_left_parenthesis);
+                    const preprocessor_token *name = peek(parenthesis ? 2 : 1);
+
+                    if(!name || name->type != identifier || (parenthesis && !is_punctuator(peek(3), punctuator_right_parenthesis)))
+                    {
+                        m_failed = true;
+                        return;
+                    }
+
+                    m_position += parenthesis ? 4 : 2;
+                    emit(opcode_defined, name->id, 1);
+                }
+                else if(token->type == identifier)
+                {
+                    keyword_type keyword = preprocessor_tokenizer::get_keyword_type(token->id);
+
+                    m_position++;
+
+                    if(keyword == keyword_true || keyword == keyword_false)
+                    {
+                        emit(opcode_push, keyword == keyword_true, 1);
+                    }
+                    else if(is_punctuator(peek(), punctuator_left_parenthesis))
+                    {
+                        //Function like macro invocations need a full expansion
+                        m_failed = true;
+                    }
+                    else
+                    {
+                        emit(opcode_macro, token->id, 1);
+                    }
+                }
+                else
+                {
+                    //Anything else is left to the full evaluation
+                    m_failed = true;
+                }
+            }
+
+            public:
+            condition_compiler(token_span expression, compiled_condition &condition)
+            :   m_position(0),
+                m_condition(condition),
+                m_depth(0),
+                m_failed(false)
+            {
+                for(size_t i=0; i<expression.size(); i++)
+                {
+                    if(!is_blank(expression[i]))
+                    {
+                        m_tokens.push_back(&expression[i]);
+                    }
+                }
+            }
+
+            void compile()
+            {
+                m_condition.code.clear();
+                m_condition.stack_size = 0;
+
+                expression();
+
+                if(m_failed || m_position != m_tokens.size() || m_condition.stack_size > max_stack_size)
+                {
+                    m_condition.code.clear();
+                }
+            }
+        };
+
+        /**
+         * Hash of the text of the tokens of an expression
+         */
+        size_t expression_hash(token_span expression)
+        {
+            size_t hash = 14695981039346656037ull;
+
+            for(size_t i=0; i<expression.size(); i++)
+            {
+                if(is_blank(expression[i]))
+                {
+                    continue;
+                }
+
+                string_view text = expression[i].token;
+
+                for(size_t c=0; c<text.size(); c++)
+                {
+                    hash ^= static_cast<unsigned char>(text[c]);
+                    hash *= 1099511628211ull;
+                }
+
+                hash ^= ' ';
+                hash *= 1099511628211ull;
+            }
+
+            return hash;
+        }
+    }
+
+	condition_cache& condition_cache::instance()
+	{
+	    static condition_cache cache;
+
+	    return cache;
+	}
+
+	void condition_cache::compile(token_span expression, compiled_condition &condition)
+	{
+	    condition_compiler compiler(expression, condition);
+
+	    compiler.compile();
+	}
+
+	const compiled_condition& condition_cache::get(atom file, size_t offset, token_span expression)
+	{
+	    condition_cache &cache = instance();
+	    unsigned long long key = (static_cast<unsigned long long>(file) << 32) | (offset & 0xFFFFFFFFu);
+	    size_t hash = expression_hash(expression);
+
+	    {
+	        shared_lock<shared_mutex> lock(cache.m_mutex);
+
+	        unordered_map<unsigned long long, const compiled_condition*>::const_iterator found = cache.m_index.find(key);
+
+	        if(found != cache.m_index.end() && found->second->hash == hash)
+	        {
+	            return *found->second;
+	        }
+	    }
+
+	    compiled_condition condition;
+
+	    condition.hash = hash;
+	    compile(expression, condition);
+
+	    unique_lock<shared_mutex> lock(cache.m_mutex);
+
+	    //Another thread could have compiled it while the lock was released
+	    unordered_map<unsigned long long, const compiled_condition*>::const_iterator found = cache.m_index.find(key);
+
+	    if(found != cache.m_index.end() && found->second->hash == hash)
+	    {
+	        return *found->second;
+	    }
+
+	    //Conditions of files that changed are replaced but kept, they could still be in use
+	    cache.m_conditions.push_back(std::move(condition));
+	    cache.m_index[key] = &cache.m_conditions.back();
+
+	    return cache.m_conditions.back();
+	}
+
+	bool condition_cache::macro_value(const macro_table &macros, atom name, integer_literal &value)
+	{
+	    atom expanding[max_macro_depth];
+
+	    for(unsigned int depth = 0; depth < max_macro_depth; depth++)
+	    {
+	        const define *macro = macros.lookup(name);
+
+	        //Names that are not macros, function like macros without arguments
+	        //and macros that refer to themselves are left as identifiers, that are 0
+	        if(!macro || macro->type == function)
+	        {
+	            value.value = 0;
+	            value.is_unsigned = false;
+	            return true;
+	        }
+
+	        for(unsigned int i = 0; i < depth; i++)
+	        {
+	            if(expanding[i] == name)
+	            {
+	                value.value = 0;
+	                value.is_unsigned = false;
+	                return true;
+	            }
+	        }
+
+	        if(macro->replacement_size != 1)
+	        {
+	            return false;
+	        }
+
+	        const preprocessor_token &token = macro->replacement[0].token;
+
+	        if(token.type == number || token.type == strings)
+	        {
+	            return preprocessor_tokenizer::get_literal(token, value);
+	        }
+
+	        if(token.type != identifier)
+	        {
+	            return false;
+	        }
+
+	        keyword_type keyword = preprocessor_tokenizer::get_keyword_type(token.id);
+
+	        if(keyword == keyword_true || keyword == keyword_false)
+	        {
+	            value.value = keyword == keyword_true;
+	            value.is_unsigned = false;
+	            return true;
+	        }
+
+	        expanding[depth] = name;
+	        name = token.id;
+	    }
+
+	    return false;
+	}
+
+	bool condition_cache::evaluate(const compiled_condition &condition, const macro_table &macros, integer_literal &value)
+	{
+	    if(condition.code.empty())
+	    {
+	        return false;
+	    }
+
+	    integer_literal stack[max_stack_size];
+	    unsigned int top = 0; //Amount of values on the stack
+	    const condition_instruction *code = condition.code.data();
+	    size_t size = condition.code.size();
+
+	    for(size_t i = 0; i < size; i++)
+	    {
+	        const condition_instruction &instruction = code[i];
+
+	        switch(instruction.opcode)
+	        {
+	            case opcode_push:
+	            case opcode_push_unsigned:
+	                stack[top].value = instruction.operand;
+	                stack[top++].is_unsigned = instruction.opcode == opcode_push_unsigned;
+	                break;
+
+	            case opcode_macro:
+	                if(!macro_value(macros, static_cast<atom>(instruction.operand), stack[top++]))
+	                {
+	                    return false;
+	                }
+	                break;
+
+	            case opcode_defined:
+	                stack[top].value = macros.find(static_cast<atom>(instruction.operand)) != no_macro;
+	                stack[top++].is_unsigned = false;
+	                break;
+
+	            case opcode_unary:
+	                stack[top - 1] = ConstExprEvaluator::unary_operation(static_cast<TokenType>(instruction.operand), stack[top - 1]);
+	                break;
+
+	            case opcode_binary:
+	                top--;
+
+	                //Divisions by zero are reported by the full evaluation
+	                if(!ConstExprEvaluator::binary_operation(static_cast<TokenType>(instruction.operand), stack[top - 1], stack[top], stack[top - 1]))
+	                {
+	                    return false;
+	                }
+	                break;
+
+	            case opcode_select:
+	                top -= 2;
+	                stack[top - 1].value = stack[top - 1].value != 0 ? stack[top].value : stack[top + 1].value;
+	                stack[top - 1].is_unsigned = stack[top].is_unsigned || stack[top + 1].is_unsigned;
+	                break;
+
+	            case opcode_to_bool:
+	                stack[top - 1].value = stack[top - 1].value != 0;
+	                stack[top - 1].is_unsigned = false;
+	                break;
+
+	            case opcode_and_jump:
+	                if(stack[top - 1].value == 0)
+	                {
+	                    stack[top - 1].is_unsigned = false;
+	                    i = instruction.operand - 1;
+	                }
+	                else
+	                {
+	                    top--;
+	                }
+	                break;
+
+	            case opcode_or_jump:
+	                if(stack[top - 1].value != 0)
+	                {
+	                    stack[top - 1].value = 1;
+	                    stack[top - 1].is_unsigned = false;
+	                    i = instruction.operand - 1;
+	                }
+	                else
+	                {
+	                    top--;
+	                }
+	                break;
+
+	            case opcode_pop:
+	                top--;
+	                break;
+	        }
+	    }
+
+	    value = stack[top - 1];
+
+	    return true;
+	}
+}
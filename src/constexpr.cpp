@@ -1,9 +1,8 @@
 #include <string>
-#include <cstdio>
-#include <cctype>
-#include <cstdlib>
 #include <iostream>
+#include <vector>
 #include "constexpr.hpp"
+#include "preprocessor_tokenizer.hpp"
 
 PCToken skipWhiteSpace(PCToken *pTokenIter)
 {
@@ -38,470 +37,483 @@ const Token &PreprocessorError::getToken() const
 
 int ConstExprEvaluator::eval(PCToken *tokenIter)
 {
-    int r = conditional_expression(tokenIter);
+    std::vector<ExprToken> tokens;
 
-    skipWhiteSpace(tokenIter);
-
-    if (peekNextToken(tokenIter)->type != ttEndOfTokens)
+    while ((*tokenIter)->type != ttEndOfTokens)
     {
-        throw PreprocessorError("Error parsing constant-expression at token " + (*tokenIter)->value, **tokenIter);
+        ExprToken token = { (*tokenIter)->type, { 0, false }, (*tokenIter)->value };
+
+        if (token.type == ttNumber || token.type == ttCharLiteral)
+        {
+            PCToken literalIter = *tokenIter;
+            token.value = literal(&literalIter);
+        }
+
+        tokens.push_back(token);
+        ++*tokenIter;
     }
 
-    return r;
+    return static_cast<int>(eval(tokens.data(), tokens.size()).value);
 }
 
-int ConstExprEvaluator::conditional_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::eval(const ExprToken *tokens, size_t count)
 {
-    int loe = logical_or_expression(tokenIter);
+    ExprResult result;
 
-    if (peekNextToken(tokenIter)->type == ttQuestion)
+    if (!eval(tokens, count, result))
     {
-        ++*tokenIter;
-        int expr = expression(tokenIter);
+        Token token = { ttEndOfTokens, "" };
 
-        if (peekNextToken(tokenIter)->type == ttColon)
+        if (result.token)
         {
-            ++*tokenIter;
-            int cexpr = conditional_expression(tokenIter);
-
-            return loe ? expr : cexpr;
+            token.type = result.token->type;
+            token.value = std::string(result.token->text);
         }
 
-        throw PreprocessorError("Missing : in ?: operator", **tokenIter);
+        throw PreprocessorError(result.message, token);
     }
 
-    return loe;
+    return result.value;
 }
 
-int ConstExprEvaluator::logical_or_expression(PCToken *tokenIter)
+bool ConstExprEvaluator::eval(const ExprToken *tokens, size_t count, ExprResult &result)
 {
-    int result = logical_and_expression(tokenIter);
+    Cursor cursor = { tokens, tokens + count, &result };
 
-    while (peekNextToken(tokenIter)->type == ttOr)
+    result.valid = true;
+    result.token = 0;
+    result.message.clear();
+
+    result.value = conditional_expression(cursor, true);
+
+    if (peek(cursor) != ttEndOfTokens)
     {
-        ++*tokenIter;
-        int tmp = logical_and_expression(tokenIter);
-        result = result || tmp;
+        error("Error parsing constant-expression at token " + spelling(cursor), cursor);
     }
 
-    return result;
+    return result.valid;
 }
 
-int ConstExprEvaluator::logical_and_expression(PCToken *tokenIter)
+TokenType ConstExprEvaluator::peek(Cursor &cursor)
 {
-    int result = inclusive_or_expression(tokenIter);
+    if (!cursor.result->valid)
+    {
+        return ttEndOfTokens;
+    }
 
-    while (peekNextToken(tokenIter)->type == ttAnd)
+    while (cursor.current != cursor.end && cursor.current->type == ttWhiteSpace)
     {
-        ++*tokenIter;
-        int tmp = inclusive_or_expression(tokenIter);
-        result = result && tmp;
+        ++cursor.current;
     }
 
-    return result;
+    return cursor.current != cursor.end ? cursor.current->type : ttEndOfTokens;
 }
 
-int ConstExprEvaluator::inclusive_or_expression(PCToken *tokenIter)
+void ConstExprEvaluator::error(const std::string &message, const Cursor &cursor)
 {
-    int result = exclusive_or_expression(tokenIter);
-
-    while (peekNextToken(tokenIter)->type == ttBitOr)
+    // Only the first error is kept, the following ones are consequences of it
+    if (!cursor.result->valid)
     {
-        ++*tokenIter;
-        result |= exclusive_or_expression(tokenIter);
+        return;
     }
 
-    return result;
+    cursor.result->valid = false;
+    cursor.result->message = message;
+    cursor.result->token = cursor.current != cursor.end ? cursor.current : 0;
 }
 
-int ConstExprEvaluator::exclusive_or_expression(PCToken *tokenIter)
+std::string ConstExprEvaluator::spelling(const Cursor &cursor)
 {
-    int result = and_expression(tokenIter);
+    return cursor.current != cursor.end ? std::string(cursor.current->text) : std::string("end of expression");
+}
 
-    while (peekNextToken(tokenIter)->type == ttBitXOr)
+int ConstExprEvaluator::binary_precedence(TokenType type)
+{
+    switch (type)
     {
-        ++*tokenIter;
-        result ^= and_expression(tokenIter);
-    }
+        case ttTimes:
+        case ttDivide:
+        case ttModulo:
+            return 10;
 
-    return result;
+        case ttPlus:
+        case ttMinus:
+            return 9;
+
+        case ttLShift:
+        case ttRShift:
+            return 8;
+
+        case ttLess:
+        case ttGreater:
+        case ttLessEqual:
+        case ttGreaterEqual:
+            return 7;
+
+        case ttEqual:
+        case ttNotEqual:
+            return 6;
+
+        case ttBitAnd:
+            return 5;
+
+        case ttBitXOr:
+            return 4;
+
+        case ttBitOr:
+            return 3;
+
+        case ttAnd:
+            return 2;
+
+        case ttOr:
+            return 1;
+
+        default:
+            return 0;
+    }
 }
 
-int ConstExprEvaluator::and_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::unary_operation(TokenType type, ExprValue operand)
 {
-    int result = equality_expression(tokenIter);
+    ExprValue result = operand;
 
-    while (peekNextToken(tokenIter)->type == ttBitAnd)
+    switch (type)
     {
-        ++*tokenIter;
-        result &= equality_expression(tokenIter);
+        case ttMinus:
+            result.value = 0 - operand.value;
+            break;
+
+        case ttNot:
+            result.value = operand.value == 0;
+            result.is_unsigned = false;
+            break;
+
+        case ttBitNeg:
+            result.value = ~operand.value;
+            break;
+
+        default:
+            break;
     }
 
     return result;
 }
 
-int ConstExprEvaluator::equality_expression(PCToken *tokenIter)
+bool ConstExprEvaluator::binary_operation(TokenType type, ExprValue left, ExprValue right, ExprValue &result)
 {
-    int result = relational_expression(tokenIter);
+    // The values are kept as uintmax_t so arithmetic wraps around instead of overflowing,
+    // the signed view is only needed to divide, compare and shift right
+    bool isUnsigned = left.is_unsigned || right.is_unsigned;
+    std::intmax_t sleft = static_cast<std::intmax_t>(left.value);
+    std::intmax_t sright = static_cast<std::intmax_t>(right.value);
+
+    result.is_unsigned = isUnsigned;
 
-    while (peekNextToken(tokenIter)->type == ttEqual || peekNextToken(tokenIter)->type == ttNotEqual)
+    switch (type)
     {
-        if (peekNextToken(tokenIter)->type == ttEqual)
-        {
-            ++*tokenIter;
-            result = result == relational_expression(tokenIter);
-        }
-        else // ttNotEqual
+        case ttTimes:
+            result.value = left.value * right.value;
+            return true;
+
+        case ttDivide:
+        case ttModulo:
+            if (right.value == 0)
+            {
+                return false;
+            }
+
+            if (isUnsigned)
+            {
+                result.value = type == ttDivide ? left.value / right.value : left.value % right.value;
+            }
+            else if (sright == -1)
+            {
+                result.value = type == ttDivide ? 0 - left.value : 0;
+            }
+            else
+            {
+                result.value = type == ttDivide ? sleft / sright : sleft % sright;
+            }
+            return true;
+
+        case ttPlus:
+            result.value = left.value + right.value;
+            return true;
+
+        case ttMinus:
+            result.value = left.value - right.value;
+            return true;
+
+        case ttLShift:
+        case ttRShift:
         {
-            ++*tokenIter;
-            result =  result != relational_expression(tokenIter);
+            // The result has the type of the left operand, shifting all the bits out gives 0 or -1
+            bool outOfRange = right.is_unsigned ? right.value >= 64 : sright < 0 || sright >= 64;
+
+            result.is_unsigned = left.is_unsigned;
+
+            if (type == ttLShift)
+            {
+                result.value = outOfRange ? 0 : left.value << right.value;
+            }
+            else if (left.is_unsigned)
+            {
+                result.value = outOfRange ? 0 : left.value >> right.value;
+            }
+            else
+            {
+                result.value = outOfRange ? (sleft < 0 ? -1 : 0) : sleft >> right.value;
+            }
+            return true;
         }
-    }
 
-    return result;
-}
+        case ttBitAnd:
+            result.value = left.value & right.value;
+            return true;
 
-int ConstExprEvaluator::relational_expression(PCToken *tokenIter)
-{
-    int result = shift_expression(tokenIter);
+        case ttBitXOr:
+            result.value = left.value ^ right.value;
+            return true;
 
-    while (peekNextToken(tokenIter)->type == ttLess || peekNextToken(tokenIter)->type == ttGreater || peekNextToken(tokenIter)->type == ttLessEqual || peekNextToken(tokenIter)->type == ttGreaterEqual)
+        case ttBitOr:
+            result.value = left.value | right.value;
+            return true;
+
+        default:
+            break;
+    }
+
+    result.is_unsigned = false;
+
+    switch (type)
     {
-        if (peekNextToken(tokenIter)->type == ttLess)
-        {
-            ++*tokenIter;
-            result = result < shift_expression(tokenIter);
-        }
-        else if (peekNextToken(tokenIter)->type == ttGreater)
-        {
-            ++*tokenIter;
-            result = result > shift_expression(tokenIter);
-        }
-        else if (peekNextToken(tokenIter)->type == ttLessEqual)
-        {
-            ++*tokenIter;
-            result = result <= shift_expression(tokenIter);
-        }
-        else // ttGreaterEqual
-        {
-            ++*tokenIter;
-            result = result >= shift_expression(tokenIter);
-        }
+        case ttLess:
+            result.value = isUnsigned ? left.value < right.value : sleft < sright;
+            break;
+
+        case ttGreater:
+            result.value = isUnsigned ? left.value > right.value : sleft > sright;
+            break;
+
+        case ttLessEqual:
+            result.value = isUnsigned ? left.value <= right.value : sleft <= sright;
+            break;
+
+        case ttGreaterEqual:
+            result.value = isUnsigned ? left.value >= right.value : sleft >= sright;
+            break;
+
+        case ttEqual:
+            result.value = left.value == right.value;
+            break;
+
+        case ttNotEqual:
+            result.value = left.value != right.value;
+            break;
+
+        case ttAnd:
+            result.value = left.value != 0 && right.value != 0;
+            break;
+
+        default: // ttOr
+            result.value = left.value != 0 || right.value != 0;
+            break;
     }
 
-    return result;
+    return true;
 }
 
-int ConstExprEvaluator::shift_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::binary_operation(TokenType type, ExprValue left, ExprValue right, bool evaluated, const Cursor &cursor)
 {
-    int result = additive_expression(tokenIter);
+    ExprValue result = { 0, false };
 
-    while (peekNextToken(tokenIter)->type == ttLShift || peekNextToken(tokenIter)->type == ttRShift)
+    if (!binary_operation(type, left, right, result) && evaluated)
     {
-        if (peekNextToken(tokenIter)->type == ttLShift)
-        {
-            ++*tokenIter;
-            result <<= additive_expression(tokenIter);
-        }
-        else // ttRShift
-        {
-            ++*tokenIter;
-            result >>= additive_expression(tokenIter);
-        }
+        error("Division by zero", cursor);
     }
 
     return result;
 }
 
-int ConstExprEvaluator::additive_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::conditional_expression(Cursor &cursor, bool evaluated)
 {
-    int result = multiplicative_expression(tokenIter);
+    ExprValue loe = binary_expression(cursor, 1, evaluated);
 
-    while (peekNextToken(tokenIter)->type == ttPlus || peekNextToken(tokenIter)->type == ttMinus)
+    if (peek(cursor) == ttQuestion)
     {
-        if (peekNextToken(tokenIter)->type == ttPlus)
-        {
-            ++*tokenIter;
-            result += multiplicative_expression(tokenIter);
-        }
-        else // ttMINUS
+        ++cursor.current;
+        ExprValue expr = expression(cursor, evaluated && loe.value != 0);
+
+        if (peek(cursor) == ttColon)
         {
-            ++*tokenIter;
-            result -= multiplicative_expression(tokenIter);
+            ++cursor.current;
+            ExprValue cexpr = conditional_expression(cursor, evaluated && loe.value == 0);
+
+            // Both sides are converted to their common type
+            ExprValue result = loe.value != 0 ? expr : cexpr;
+            result.is_unsigned = expr.is_unsigned || cexpr.is_unsigned;
+
+            return result;
         }
+
+        error("Missing : in ?: operator", cursor);
     }
 
-    return result;
+    return loe;
 }
 
-int ConstExprEvaluator::multiplicative_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::binary_expression(Cursor &cursor, int minimumPrecedence, bool evaluated)
 {
-    int result = unary_expression(tokenIter);
+    ExprValue result = unary_expression(cursor, evaluated);
 
-    while (peekNextToken(tokenIter)->type == ttTimes || peekNextToken(tokenIter)->type == ttDivide || peekNextToken(tokenIter)->type == ttModulo)
+    while (true)
     {
-        if (peekNextToken(tokenIter)->type == ttTimes)
+        TokenType type = peek(cursor);
+        int precedence = binary_precedence(type);
+
+        if (precedence == 0 || precedence < minimumPrecedence)
         {
-            ++*tokenIter;
-            result *= unary_expression(tokenIter);
+            return result;
         }
-        else if (peekNextToken(tokenIter)->type == ttDivide)
+
+        Cursor operation = cursor;
+        ++cursor.current;
+
+        // The right side of && and || doesn't count when the left one already decides
+        bool rightEvaluated = evaluated;
+
+        if (type == ttAnd)
         {
-            ++*tokenIter;
-            result /= unary_expression(tokenIter);
+            rightEvaluated = evaluated && result.value != 0;
         }
-        else // ttModulo
+        else if (type == ttOr)
         {
-            ++*tokenIter;
-            result %= unary_expression(tokenIter);
+            rightEvaluated = evaluated && result.value == 0;
         }
-    }
 
-    return result;
-}
+        ExprValue right = binary_expression(cursor, precedence + 1, rightEvaluated);
 
-int ConstExprEvaluator::unary_expression(PCToken *tokenIter)
-{
-    if (peekNextToken(tokenIter)->type == ttPlus)
-    {
-        ++*tokenIter;
-        return unary_expression(tokenIter);
+        result = binary_operation(type, result, right, evaluated, operation);
     }
-
-    if (peekNextToken(tokenIter)->type == ttMinus)
-    {
-        ++*tokenIter;
-        return -unary_expression(tokenIter);
-    }
-
-    if (peekNextToken(tokenIter)->type == ttNot)
-    {
-        ++*tokenIter;
-        return !unary_expression(tokenIter);
-    }
-
-    if (peekNextToken(tokenIter)->type == ttBitNeg)
-    {
-        ++*tokenIter;
-        return ~unary_expression(tokenIter);
-    }
-
-    return primary_expression(tokenIter);
 }
 
-int ConstExprEvaluator::primary_expression(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::unary_expression(Cursor &cursor, bool evaluated)
 {
-    if (peekNextToken(tokenIter)->type == ttLParen)
+    TokenType type = peek(cursor);
+
+    switch (type)
     {
-        ++*tokenIter;
-        int result = expression(tokenIter);
+        case ttPlus:
+            ++cursor.current;
+            return unary_expression(cursor, evaluated);
 
-        if (peekNextToken(tokenIter)->type == ttRParen)
-        {
-            ++*tokenIter;
-            return result;
-        }
+        case ttMinus:
+        case ttNot:
+        case ttBitNeg:
+            ++cursor.current;
+            return unary_operation(type, unary_expression(cursor, evaluated));
 
-        throw PreprocessorError("Expected ')', but found " + peekNextToken(tokenIter)->value, **tokenIter);
+        default:
+            return primary_expression(cursor, evaluated);
     }
-
-    return literal(tokenIter);
 }
 
-int ConstExprEvaluator::literal(PCToken *tokenIter)
+ExprValue ConstExprEvaluator::primary_expression(Cursor &cursor, bool evaluated)
 {
-    switch (peekNextToken(tokenIter)->type)
+    ExprValue result = { 0, false };
+
+    switch (peek(cursor))
     {
-        case ttNumber:
+        case ttLParen:
         {
-            int result;
-            char dummy1 = 0;
-            char dummy2 = 0;
-            char dummy3 = 0;
-            int count = std::sscanf(peekNextToken(tokenIter)->value.c_str(), "%i%c%c%c", &result, &dummy1, &dummy2, &dummy3);
+            ++cursor.current;
+            result = expression(cursor, evaluated);
 
-            switch (count)
+            if (peek(cursor) == ttRParen)
             {
-                case 1:
-                    ++*tokenIter;
-                    return result;
-
-                case 2:
-                    if (dummy1 == 'u' || dummy1 == 'U' || dummy1 == 'l' || dummy1 == 'L')
-                    {
-                        ++*tokenIter;
-                        return result;
-                    }
-                    break;
-
-                case 3:
-                    if (dummy1 == 'u' || dummy1 == 'U')
-                    {
-                        if (dummy2 == 'l' || dummy2 == 'L')
-                        {
-                            ++*tokenIter;
-                            return result;
-                        }
-                    }
-
-                    if (dummy1 == 'l' || dummy1 == 'L')
-                    {
-                        if (dummy2 == 'u' || dummy2 == 'U')
-                        {
-                            ++*tokenIter;
-                            return result;
-                        }
-                    }
-                    break;
-
-                default:
-                    break;
+                ++cursor.current;
+                return result;
             }
 
-            double fresult;
-
-            count = std::sscanf(peekNextToken(tokenIter)->value.c_str(), "%lg%c%c%c", &fresult, &dummy1, &dummy2, &dummy3);
-
-            switch (count)
-            {
-                case 1:
-                    ++*tokenIter;
-                    return static_cast<int>(fresult);
-
-                case 2:
-                    if (dummy1 == 'f' || dummy1 == 'F' || dummy1 == 'l' || dummy1 == 'L')
-                    {
-                        ++*tokenIter;
-                        return static_cast<int>(fresult);
-                    }
-                    break;
-
-                default:
-                    throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid number", **tokenIter);
-            }
+            error("Expected ')', but found " + spelling(cursor), cursor);
+            return result;
         }
 
+        case ttNumber:
         case ttCharLiteral:
-        {
-            size_t pos = 0;
+            return (cursor.current++)->value;
+
+        case ttTrue:
+            ++cursor.current;
+            result.value = 1;
+            return result;
 
-            if (peekNextToken(tokenIter)->value[pos] == 'L')
+        case ttFalse:
+            ++cursor.current;
+            return result;
+
+        default:
+            if (cursor.current == cursor.end)
             {
-                ++pos;
+                error("Expected a value, but found end of expression", cursor);
             }
-
-            if (peekNextToken(tokenIter)->value.length() == pos + 3) // 'c' or L'c' (pos points to the first ')
+            else
             {
-                int ret = peekNextToken(tokenIter)->value[++pos];
-                ++*tokenIter;
-                return ret;
+                error(spelling(cursor) + " is not a valid literal", cursor);
             }
+            return result;
+    }
+}
 
-            ++pos;
+ExprValue ConstExprEvaluator::expression(Cursor &cursor, bool evaluated)
+{
+    ExprValue result = conditional_expression(cursor, evaluated);
 
-            size_t end = peekNextToken(tokenIter)->value.length() - 1;
+    while (peek(cursor) == ttComma)
+    {
+        ++cursor.current;
+        result = conditional_expression(cursor, evaluated);
+    }
 
-            if (end == pos || peekNextToken(tokenIter)->value[pos] != '\\')
-            {
-                throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid character", **tokenIter);
-            }
+    return result;
+}
 
-            ++pos;
+ExprValue ConstExprEvaluator::literal(PCToken *tokenIter)
+{
+    ExprValue result = { 0, false };
 
-            if (peekNextToken(tokenIter)->value.length() == pos + 2) // '\n', '\r'... or L'\n', L'\r'... (pos points to what's after \)
+    switch (peekNextToken(tokenIter)->type)
+    {
+        case ttNumber:
+            // Only integers are valid, floating literals are rejected
+            if (!cpp_parser::preprocessor_tokenizer::decode_integer(peekNextToken(tokenIter)->value, result))
             {
-                switch (peekNextToken(tokenIter)->value[pos])
-                {
-                    case '\\':
-                    case '\'':
-                    case '"':
-                    case '?':
-                    {
-                        int ret = peekNextToken(tokenIter)->value[pos];
-                        ++*tokenIter;
-                        return ret;
-                    }
-
-                    case 'a':
-                        ++*tokenIter;
-                        return '\a';
-
-                    case 'b':
-                        ++*tokenIter;
-                        return '\b';
-
-                    case 'f':
-                        ++*tokenIter;
-                        return '\f';
-
-                    case 'n':
-                        ++*tokenIter;
-                        return '\n';
-
-                    case 'r':
-                        ++*tokenIter;
-                        return '\r';
-
-                    case 't':
-                        ++*tokenIter;
-                        return '\t';
-
-                    case 'v':
-                        ++*tokenIter;
-                        return '\v';
-
-                    default:
-                        if (std::isdigit(peekNextToken(tokenIter)->value[pos]))
-                        {
-                            int ret = peekNextToken(tokenIter)->value[pos] - '0';
-                            ++*tokenIter;
-                            return ret;
-                        }
-
-                        throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid character", **tokenIter);
-                }
+                throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid number", **tokenIter);
             }
 
-            int result;
+            ++*tokenIter;
+            return result;
 
-            if (peekNextToken(tokenIter)->value[pos] == 'x')
+        case ttCharLiteral:
+            if (!cpp_parser::preprocessor_tokenizer::decode_character(peekNextToken(tokenIter)->value, result))
             {
-                ++pos;
-                std::string tmp = peekNextToken(tokenIter)->value.substr(pos, peekNextToken(tokenIter)->value.length() - pos);
-                int ret = static_cast<int>(std::strtol(tmp.c_str(), 0, 16));
-                ++*tokenIter;
-                return ret;
+                throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid character", **tokenIter);
             }
 
-            std::sscanf(&peekNextToken(tokenIter)->value.c_str()[pos], "%i", &result);
             ++*tokenIter;
             return result;
 
-        }
-        break;
-
         case ttTrue:
             ++*tokenIter;
-            return 1;
+            result.value = 1;
+            return result;
 
         case ttFalse:
             ++*tokenIter;
-            return 0;
+            return result;
 
         default:
             throw PreprocessorError(peekNextToken(tokenIter)->value + " is not a valid literal", **tokenIter);
     }
-}
-
-int ConstExprEvaluator::expression(PCToken *tokenIter)
-{
-    int result = conditional_expression(tokenIter);
-
-    while (peekNextToken(tokenIter)->type == ttComma)
-    {
-        ++*tokenIter;
-        result = conditional_expression(tokenIter);
-    }
-
-    return result;
 }
@@ -0,0 +1,216 @@
+#include <mutex>
+#include "atom_table.hpp"
+#include "file_cache.hpp"
+#include "preprocessor_tokenizer.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        /**
+         * Checks if a loaded file is the given version
+         */
+        inline bool same_version(const cached_file &file, const file_stamp &stamp)
+        {
+            return file.stamp.modified == stamp.modified && file.stamp.size == stamp.size;
+        }
+    }
+
+	file_cache::file_cache(size_t budget)
+	:   m_budget(budget),
+	    m_memory(0),
+	    m_clock(0),
+	    m_file_hits(0),
+	    m_file_misses(0),
+	    m_chunk_hits(0),
+	    m_chunk_misses(0),
+	    m_evictions(0)
+	{
+	}
+
+	void file_cache::set_budget(size_t budget)
+	{
+	    unique_lock<shared_mutex> lock(m_mutex);
+
+	    m_budget = budget;
+
+	    evict(0);
+	}
+
+	file_cache_statistics file_cache::get_statistics() const
+	{
+	    shared_lock<shared_mutex> lock(m_mutex);
+
+	    file_cache_statistics statistics;
+	    statistics.file_hits = m_file_hits;
+	    statistics.file_misses = m_file_misses;
+	    statistics.chunk_hits = m_chunk_hits;
+	    statistics.chunk_misses = m_chunk_misses;
+	    statistics.evictions = m_evictions;
+	    statistics.memory = m_memory;
+	    statistics.files = m_files.size();
+
+	    return statistics;
+	}
+
+	void file_cache::evict(const cached_file *keep)
+	{
+	    while(m_memory > m_budget)
+	    {
+	        unordered_map<file_identity, shared_ptr<cached_file>, file_identity_hash>::iterator oldest = m_files.end();
+
+	        for(unordered_map<file_identity, shared_ptr<cached_file>, file_identity_hash>::iterator file = m_files.begin(); file != m_files.end(); file++)
+	        {
+	            if(file->second.get() != keep && (oldest == m_files.end() || file->second->last_use < oldest->second->last_use))
+	            {
+	                oldest = file;
+	            }
+	        }
+
+	        if(oldest == m_files.end())
+	        {
+	            break;
+	        }
+
+	        //Preprocessors still using the file keep it alive
+	        oldest->second->cached = false;
+	        m_memory -= oldest->second->memory;
+	        m_files.erase(oldest);
+	        m_evictions++;
+	    }
+	}
+
+	shared_ptr<cached_file> file_cache::get_file(const string &path, const file_stamp &stamp)
+	{
+	    {
+	        shared_lock<shared_mutex> lock(m_mutex);
+
+	        unordered_map<file_identity, shared_ptr<cached_file>, file_identity_hash>::const_iterator found = m_files.find(stamp.identity);
+
+	        if(found != m_files.end() && same_version(*found->second, stamp))
+	        {
+	            found->second->last_use = ++m_clock;
+	            m_file_hits++;
+
+	            return found->second;
+	        }
+	    }
+
+	    m_file_misses++;
+
+	    //Loaded without holding the lock, other threads can use the cache meanwhile
+	    shared_ptr<source_buffer> source(new source_buffer());
+
+	    if(!source->open(path))
+	    {
+	        return shared_ptr<cached_file>();
+	    }
+
+	    shared_ptr<cached_file> file(new cached_file());
+	    file->stamp = stamp;
+	    file->source = source;
+	    file->base = source_manager::add_file(source, atom_table::intern(path), stamp);
+	    file->memory = source->size();
+	    file->last_use = ++m_clock;
+	    file->cached = true;
+
+	    unique_lock<shared_mutex> lock(m_mutex);
+
+	    unordered_map<file_identity, shared_ptr<cached_file>, file_identity_hash>::iterator found = m_files.find(stamp.identity);
+
+	    if(found != m_files.end())
+	    {
+	        //Loaded by another thread meanwhile
+	        if(same_version(*found->second, stamp))
+	        {
+	            found->second->last_use = ++m_clock;
+
+	            return found->second;
+	        }
+
+	        found->second->cached = false;
+	        m_memory -= found->second->memory;
+	        m_files.erase(found);
+	    }
+
+	    m_files[stamp.identity] = file;
+	    m_memory += file->memory;
+
+	    evict(file.get());
+
+	    return file;
+	}
+
+	shared_ptr<const token_chunk> file_cache::get_chunk(const shared_ptr<cached_file> &file, size_t position)
+	{
+	    {
+	        shared_lock<shared_mutex> file_lock(file->mutex);
+
+	        unordered_map<size_t, shared_ptr<const token_chunk>>::const_iterator found = file->chunks.find(position);
+
+	        if(found != file->chunks.end())
+	        {
+	            m_chunk_hits++;
+
+	            return found->second;
+	        }
+	    }
+
+	    m_chunk_misses++;
+
+	    shared_ptr<token_chunk> chunk(new token_chunk());
+	    chunk->lines = tokenized_file(file->source, file->base);
+	    chunk->end_position = position;
+
+	    preprocessor_tokenizer::tokenize_lines(file->source->data(), file->source->size(), chunk->end_position, chunk->lines);
+
+	    chunk->lines.shrink_to_fit();
+
+	    size_t memory = sizeof(token_chunk) + chunk->lines.memory_size();
+
+	    {
+	        //The shared lock stops the file from being evicted while its memory is updated
+	        shared_lock<shared_mutex> lock(m_mutex);
+	        unique_lock<shared_mutex> file_lock(file->mutex);
+
+	        pair<unordered_map<size_t, shared_ptr<const token_chunk>>::iterator, bool> inserted = file->chunks.emplace(position, chunk);
+
+	        //Tokenized by another thread meanwhile
+	        if(!inserted.second)
+	        {
+	            return inserted.first->second;
+	        }
+
+	        file->memory += memory;
+
+	        if(file->cached)
+	        {
+	            m_memory += memory;
+	        }
+	    }
+
+	    if(m_memory > m_budget)
+	    {
+	        unique_lock<shared_mutex> lock(m_mutex);
+
+	        evict(file.get());
+	    }
+
+	    return chunk;
+	}
+
+	void file_cache::clear()
+	{
+	    unique_lock<shared_mutex> lock(m_mutex);
+
+	    for(unordered_map<file_identity, shared_ptr<cached_file>, file_identity_hash>::iterator file = m_files.begin(); file != m_files.end(); file++)
+	    {
+	        file->second->cached = false;
+	    }
+
+	    m_files.clear();
+	    m_memory = 0;
+	}
+}
@@ -0,0 +1,178 @@
+#include <dirent.h>
+#include "include_resolver.hpp"
+#include "misc.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+	void include_resolver::set_directories(vector<directory> &directories, const vector<string> &paths)
+	{
+	    directories.clear();
+
+	    for(unsigned int i=0; i<paths.size(); i++)
+	    {
+	        if(paths[i].empty())
+	        {
+	            continue;
+	        }
+
+	        directory search_directory;
+	        search_directory.path = paths[i];
+	        search_directory.listed = false;
+
+	        if(search_directory.path.back() != '/')
+	        {
+	            search_directory.path += "/";
+	        }
+
+	        directories.push_back(search_directory);
+	    }
+	}
+
+	void include_resolver::set_local_directories(const vector<string> &paths)
+	{
+	    set_directories(m_local, paths);
+	    clear();
+	}
+
+	void include_resolver::set_global_directories(const vector<string> &paths)
+	{
+	    set_directories(m_global, paths);
+	    clear();
+	}
+
+	bool include_resolver::probe(directory &search_directory, string_view file)
+	{
+	    //Headers whose first component is not on the directory are not searched there
+	    if(m_listing)
+	    {
+	        if(!search_directory.listed)
+	        {
+	            DIR *listing = opendir(search_directory.path.c_str());
+
+	            if(listing)
+	            {
+	                while(dirent *entry = readdir(listing))
+	                {
+	                    search_directory.entries.insert(entry->d_name);
+	                }
+
+	                closedir(listing);
+	            }
+
+	            search_directory.listed = true;
+	        }
+
+	        if(search_directory.entries.count(string(file.substr(0, file.find('/')))) == 0)
+	        {
+	            return false;
+	        }
+	    }
+
+	    m_path = search_directory.path;
+	    m_path += file;
+
+	    return file_exists(m_path);
+	}
+
+	include_resolver::resolution include_resolver::search(string_view file, unsigned int first)
+	{
+	    unsigned int directories = m_local.size() + m_global.size();
+
+	    for(unsigned int i=first; i<directories; i++)
+	    {
+	        directory &search_directory = i < m_local.size() ? m_local[i] : m_global[i - m_local.size()];
+
+	        if(probe(search_directory, file))
+	        {
+	            resolution found = { atom_table::intern(m_path), i };
+
+	            return found;
+	        }
+	    }
+
+	    resolution missing = { no_atom, no_directory };
+
+	    return missing;
+	}
+
+	atom include_resolver::resolve(string_view file, file_scope scope, atom includer_directory, unsigned int *directory)
+	{
+	    if(scope == global)
+	    {
+	        includer_directory = no_atom;
+	    }
+
+	    //Atoms are below 2^31 so the three values fit on the key
+	    unsigned long long key = (static_cast<unsigned long long>(atom_table::intern(file)) << 32)
+	        | (static_cast<unsigned long long>(includer_directory) << 1) | (scope == local ? 1 : 0);
+
+	    unordered_map<unsigned long long, resolution>::const_iterator cached = m_cache.find(key);
+
+	    if(cached == m_cache.end())
+	    {
+	        resolution found = { no_atom, no_directory };
+
+	        if(!file.empty() && file[0] == '/')
+	        {
+	            m_path = file;
+
+	            if(file_exists(m_path))
+	            {
+	                found.path = atom_table::intern(m_path);
+	            }
+	        }
+	        else if(!file.empty())
+	        {
+	            if(includer_directory != no_atom)
+	            {
+	                m_path = atom_table::get_spelling(includer_directory);
+	                m_path += file;
+
+	                if(file_exists(m_path))
+	                {
+	                    found.path = atom_table::intern(m_path);
+	                }
+	            }
+
+	            //The local directories are only searched for headers enclosed in ""
+	            if(found.path == no_atom)
+	            {
+	                found = search(file, scope == local ? 0 : m_local.size());
+	            }
+	        }
+
+	        cached = m_cache.insert(make_pair(key, found)).first;
+	    }
+
+	    if(directory)
+	    {
+	        *directory = cached->second.directory;
+	    }
+
+	    return cached->second.path;
+	}
+
+	atom include_resolver::resolve_next(string_view file, file_scope scope, unsigned int after, unsigned int &directory)
+	{
+	    unsigned int first = after + 1;
+
+	    if(scope == global && first < m_local.size())
+	    {
+	        first = m_local.size();
+	    }
+
+	    unsigned long long key = (static_cast<unsigned long long>(atom_table::intern(file)) << 32) | first;
+	    unordered_map<unsigned long long, resolution>::const_iterator cached = m_next_cache.find(key);
+
+	    if(cached == m_next_cache.end())
+	    {
+	        cached = m_next_cache.insert(make_pair(key, search(file, first))).first;
+	    }
+
+	    directory = cached->second.directory;
+
+	    return cached->second.path;
+	}
+}
@@ -0,0 +1,689 @@
+#include <cstring>
+#include "macro_expander.hpp"
+#include "preprocessor_tokenizer.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        const size_t text_block_size = 64 * 1024;
+        const size_t not_expanded = ~size_t(0);
+
+        /**
+         * Checks if a token is a given punctuator
+         */
+        inline bool is_punctuator(const preprocessor_token &token, punctuator_type kind)
+        {
+            return token.type != identifier && token.type != number && token.type != strings && token.id == static_cast<unsigned int>(kind);
+        }
+
+        /**
+         * Checks if a token is only white space for the expansion
+         */
+        inline bool is_blank(const preprocessor_token &token)
+        {
+            return token.type == comment || token.type == multi_comment || token.type == new_line;
+        }
+
+        /**
+         * Checks if the first token of the lines that follow a given one is a (, without reading them.
+         * The lines of a directive are not code so they end the search.
+         * @param file The lines, null if the input is limited to a range
+         * @param line Index of the line the search starts after
+         */
+        bool parenthesis_follows(const tokenized_file *file, size_t line)
+        {
+            if(!file)
+            {
+                return false;
+            }
+
+            for(line++; line < file->size(); line++)
+            {
+                token_span tokens = (*file)[line];
+
+                if(!tokens.empty() && is_punctuator(tokens[0], punctuator_hash))
+                {
+                    return false;
+                }
+
+                for(const preprocessor_token &token : tokens)
+                {
+                    if(!is_blank(token))
+                    {
+                        return is_punctuator(token, punctuator_left_parenthesis);
+                    }
+                }
+            }
+
+            return false;
+        }
+    }
+
+	macro_expander::macro_expander(const macro_table &macros)
+	:   m_macros(macros),
+	    m_text_block(0),
+	    m_text_used(0)
+	{
+	    hide_set_node empty = { no_atom, 0 };
+
+	    m_hide_sets.push_back(empty);
+	}
+
+	macro_expander::expansion_frame& macro_expander::get_frame(unsigned int depth)
+	{
+	    while(m_frames.size() <= depth)
+	    {
+	        m_frames.push_back(unique_ptr<expansion_frame>(new expansion_frame()));
+	    }
+
+	    return *m_frames[depth];
+	}
+
+	const vector<expanded_token>& macro_expander::expand_line(const tokenized_file &file, size_t &line)
+	{
+	    token_span tokens = file[line];
+	    token_reader reader = {};
+
+	    reader.file = &file;
+	    reader.line = line;
+	    reader.current = tokens.begin();
+	    reader.end = tokens.end();
+
+	    m_output.clear();
+	    m_text_block = 0;
+	    m_text_used = 0;
+	    m_large_texts.clear();
+
+	    expand_tokens(reader, m_output, 0);
+
+	    line = reader.line;
+
+	    return m_output;
+	}
+
+	const vector<expanded_token>& macro_expander::expand(token_span tokens)
+	{
+	    token_reader reader = {};
+
+	    reader.current = tokens.begin();
+	    reader.end = tokens.end();
+
+	    m_output.clear();
+	    m_text_block = 0;
+	    m_text_used = 0;
+	    m_large_texts.clear();
+
+	    expand_tokens(reader, m_output, 0);
+
+	    return m_output;
+	}
+
+	bool macro_expander::next_token(token_reader &reader, vector<expanded_token> &pending, expanded_token &token, bool next_lines)
+	{
+	    if(!pending.empty())
+	    {
+	        token = pending.back();
+	        pending.pop_back();
+
+	        return true;
+	    }
+
+	    if(reader.expanded)
+	    {
+	        if(reader.expanded == reader.expanded_end)
+	        {
+	            return false;
+	        }
+
+	        token = *reader.expanded++;
+
+	        return true;
+	    }
+
+	    while(true)
+	    {
+	        while(reader.current == reader.end)
+	        {
+	            if(!next_lines || !reader.file || reader.line + 1 >= reader.file->size())
+	            {
+	                return false;
+	            }
+
+	            //Arguments can continue on the next lines but not over a directive
+	            token_span line = (*reader.file)[reader.line + 1];
+
+	            if(!line.empty() && is_punctuator(line[0], punctuator_hash))
+	            {
+	                return false;
+	            }
+
+	            reader.line++;
+	            reader.current = line.begin();
+	            reader.end = line.end();
+	            reader.space = true;
+	        }
+
+	        const preprocessor_token &source = *reader.current++;
+
+	        if(source.type == new_line)
+	        {
+	            reader.space = true;
+	            continue;
+	        }
+
+	        token.token = source;
+	        token.hide_set = 0;
+	        token.leading_space = reader.space || (reader.previous_end && source.token.data() != reader.previous_end);
+	        token.from_source = true;
+
+	        reader.previous_end = source.token.data() + source.token.size();
+	        reader.space = false;
+
+	        return true;
+	    }
+	}
+
+	void macro_expander::expand_tokens(token_reader &reader, vector<expanded_token> &output, unsigned int depth)
+	{
+	    expansion_frame &frame = get_frame(depth);
+	    expanded_token token;
+
+	    frame.pending.clear();
+
+	    while(next_token(reader, frame.pending, token, false))
+	    {
+	        if(token.token.type == identifier && !hide_set_contains(token.hide_set, token.token.id))
+	        {
+	            const define *macro = m_macros.lookup(token.token.id);
+
+	            if(macro)
+	            {
+	                unsigned int hide_set = 0;
+	                bool expand = false;
+
+	                if(macro->type != function)
+	                {
+	                    hide_set = hide_set_add(token.hide_set, token.token.id);
+	                    expand = true;
+	                }
+	                else
+	                {
+	                    unsigned int closing = 0;
+
+	                    if(read_arguments(reader, frame, *macro, closing))
+	                    {
+	                        hide_set = hide_set_add(hide_set_intersection(token.hide_set, closing), token.token.id);
+	                        expand = true;
+	                    }
+	                }
+
+	                if(expand)
+	                {
+	                    substitute(frame, *macro, token, hide_set, depth);
+
+	                    //The result is rescanned together with the rest of the input
+	                    for(size_t i=frame.result.size(); i>0; i--)
+	                    {
+	                        frame.pending.push_back(frame.result[i - 1]);
+	                    }
+
+	                    continue;
+	                }
+	            }
+	        }
+
+	        output.push_back(token);
+	    }
+	}
+
+	bool macro_expander::read_arguments(token_reader &reader, expansion_frame &frame, const define &macro, unsigned int &closing)
+	{
+	    expanded_token token;
+	    bool found = false;
+
+	    frame.consumed.clear();
+	    frame.arguments.clear();
+	    frame.argument_starts.clear();
+
+	    //The name must be followed by ( to be an invocation, the next lines are only
+	    //read if it is there so the lines after a name that is not invoked stay apart
+	    bool next_lines = false;
+
+	    while(true)
+	    {
+	        if(!next_token(reader, frame.pending, token, next_lines))
+	        {
+	            if(next_lines || !parenthesis_follows(reader.file, reader.line))
+	            {
+	                break;
+	            }
+
+	            next_lines = true;
+	            continue;
+	        }
+
+	        frame.consumed.push_back(token);
+
+	        if(!is_blank(token.token))
+	        {
+	            found = is_punctuator(token.token, punctuator_left_parenthesis);
+	            break;
+	        }
+	    }
+
+	    if(found)
+	    {
+	        size_t parameters = macro.parameters.size();
+	        unsigned int nesting = 0;
+	        bool space = false;
+
+	        found = false;
+	        frame.argument_starts.push_back(0);
+
+	        while(next_token(reader, frame.pending, token, true))
+	        {
+	            frame.consumed.push_back(token);
+
+	            if(is_blank(token.token))
+	            {
+	                space = true;
+	                continue;
+	            }
+
+	            if(is_punctuator(token.token, punctuator_left_parenthesis))
+	            {
+	                nesting++;
+	            }
+	            else if(is_punctuator(token.token, punctuator_right_parenthesis))
+	            {
+	                if(nesting == 0)
+	                {
+	                    closing = token.hide_set;
+	                    found = true;
+	                    break;
+	                }
+
+	                nesting--;
+	            }
+	            else if(nesting == 0 && is_punctuator(token.token, punctuator_comma) && !(macro.variadic && frame.argument_starts.size() >= parameters))
+	            {
+	                frame.argument_starts.push_back(frame.arguments.size());
+	                space = false;
+	                continue;
+	            }
+
+	            token.leading_space = token.leading_space || space;
+	            space = false;
+
+	            frame.arguments.push_back(token);
+	        }
+
+	        frame.argument_starts.push_back(frame.arguments.size());
+
+	        size_t arguments = frame.argument_starts.size() - 1;
+
+	        if(parameters == 0 && arguments == 1 && frame.arguments.empty())
+	        {
+	            //F() gives one empty argument that matches a macro without parameters
+	            frame.argument_starts.pop_back();
+	            arguments = 0;
+	        }
+	        else if(macro.variadic && arguments + 1 == parameters)
+	        {
+	            //The variadic arguments can be omitted
+	            frame.argument_starts.push_back(frame.arguments.size());
+	            arguments++;
+	        }
+
+	        found = found && arguments == parameters;
+	    }
+
+	    if(!found)
+	    {
+	        //Not an invocation, the tokens read are returned to the input
+	        for(size_t i=frame.consumed.size(); i>0; i--)
+	        {
+	            frame.pending.push_back(frame.consumed[i - 1]);
+	        }
+	    }
+
+	    return found;
+	}
+
+	void macro_expander::substitute(expansion_frame &frame, const define &macro, const expanded_token &name, unsigned int hide_set, unsigned int depth)
+	{
+	    frame.result.clear();
+	    frame.expanded.clear();
+
+	    if(macro.type == function)
+	    {
+	        frame.expanded_starts.assign(macro.parameters.size(), not_expanded);
+	        frame.expanded_ends.assign(macro.parameters.size(), 0);
+	    }
+
+	    const replacement_token *body = macro.replacement;
+	    size_t count = macro.replacement_size;
+	    bool placemarker = false; //The result ends with an empty argument that is an operand of ##
+
+	    for(size_t i=0; i<count; i++)
+	    {
+	        const preprocessor_token &token = body[i].token;
+	        bool token_space = body[i].leading_space;
+	        int parameter = body[i].parameter;
+
+	        //Stringification of a parameter
+	        if(is_punctuator(token, punctuator_hash) && i + 1 < count && body[i + 1].parameter >= 0)
+	        {
+	            i++;
+
+	            expanded_token text = stringify(frame, body[i].parameter);
+	            text.leading_space = token_space;
+
+	            frame.result.push_back(text);
+	            placemarker = false;
+
+	            continue;
+	        }
+
+	        //Pasting of the previous token with the next one or the first of an argument
+	        if(is_punctuator(token, punctuator_hash_hash) && i + 1 < count && (placemarker || !frame.result.empty()))
+	        {
+	            i++;
+
+	            int right_parameter = body[i].parameter;
+	            expanded_token single;
+	            const expanded_token *begin = &single;
+	            const expanded_token *end = begin + 1;
+
+	            if(right_parameter >= 0)
+	            {
+	                begin = frame.arguments.data() + frame.argument_starts[right_parameter];
+	                end = frame.arguments.data() + frame.argument_starts[right_parameter + 1];
+	            }
+	            else
+	            {
+	                single.token = body[i].token;
+	                single.hide_set = 0;
+	                single.leading_space = body[i].leading_space;
+	                single.from_source = false;
+	            }
+
+	            if(begin == end)
+	            {
+	                //GNU extension: , ## __VA_ARGS__ removes the comma when there are no variadic arguments
+	                if(macro.variadic && right_parameter + 1 == static_cast<int>(macro.parameters.size()) && !placemarker && is_punctuator(frame.result.back().token, punctuator_comma))
+	                {
+	                    frame.result.pop_back();
+	                }
+
+	                continue;
+	            }
+
+	            if(!placemarker && paste(frame.result.back(), *begin))
+	            {
+	                begin++;
+	            }
+
+	            frame.result.insert(frame.result.end(), begin, end);
+	            placemarker = false;
+
+	            continue;
+	        }
+
+	        //Replacement of a parameter
+	        if(parameter >= 0)
+	        {
+	            size_t first = frame.result.size();
+
+	            if(i + 1 < count && is_punctuator(body[i + 1].token, punctuator_hash_hash))
+	            {
+	                //Operands of ## are not expanded
+	                frame.result.insert(frame.result.end(), frame.arguments.begin() + frame.argument_starts[parameter], frame.arguments.begin() + frame.argument_starts[parameter + 1]);
+	                placemarker = frame.result.size() == first;
+	            }
+	            else
+	            {
+	                size_t begin = 0, end = 0;
+
+	                expand_argument(frame, parameter, depth, begin, end);
+
+	                frame.result.insert(frame.result.end(), frame.expanded.begin() + begin, frame.expanded.begin() + end);
+	                placemarker = false;
+	            }
+
+	            if(frame.result.size() > first)
+	            {
+	                frame.result[first].leading_space = token_space;
+	            }
+
+	            continue;
+	        }
+
+	        expanded_token copy;
+
+	        copy.token = token;
+	        copy.hide_set = 0;
+	        copy.leading_space = token_space;
+	        copy.from_source = false;
+
+	        frame.result.push_back(copy);
+	        placemarker = false;
+	    }
+
+	    //The produced tokens take the place of the macro name
+	    for(size_t i=0; i<frame.result.size(); i++)
+	    {
+	        expanded_token &result = frame.result[i];
+
+	        result.hide_set = hide_set_union(result.hide_set, hide_set);
+	        result.token.location = name.token.location;
+	        result.from_source = false;
+	    }
+
+	    if(!frame.result.empty())
+	    {
+	        frame.result[0].leading_space = name.leading_space;
+	    }
+	}
+
+	void macro_expander::expand_argument(expansion_frame &frame, size_t argument, unsigned int depth, size_t &begin, size_t &end)
+	{
+	    if(frame.expanded_starts[argument] == not_expanded)
+	    {
+	        token_reader reader = {};
+
+	        reader.expanded = frame.arguments.data() + frame.argument_starts[argument];
+	        reader.expanded_end = frame.arguments.data() + frame.argument_starts[argument + 1];
+
+	        frame.expanded_starts[argument] = frame.expanded.size();
+
+	        //Each argument is expanded alone, as if it was the rest of the file
+	        expand_tokens(reader, frame.expanded, depth + 1);
+
+	        frame.expanded_ends[argument] = frame.expanded.size();
+	    }
+
+	    begin = frame.expanded_starts[argument];
+	    end = frame.expanded_ends[argument];
+	}
+
+	expanded_token macro_expander::stringify(const expansion_frame &frame, size_t argument)
+	{
+	    m_spelling = "\"";
+
+	    for(size_t i=frame.argument_starts[argument]; i<frame.argument_starts[argument + 1]; i++)
+	    {
+	        const preprocessor_token &token = frame.arguments[i].token;
+
+	        if(i > frame.argument_starts[argument] && frame.arguments[i].leading_space)
+	        {
+	            m_spelling += ' ';
+	        }
+
+	        if(token.type == strings)
+	        {
+	            //Quotes and backslashes of string and character literals are escaped
+	            for(size_t c=0; c<token.token.size(); c++)
+	            {
+	                if(token.token[c] == '"' || token.token[c] == '\\')
+	                {
+	                    m_spelling += '\\';
+	                }
+
+	                m_spelling += token.token[c];
+	            }
+	        }
+	        else
+	        {
+	            m_spelling += token.token;
+	        }
+	    }
+
+	    m_spelling += '"';
+
+	    expanded_token text;
+
+	    text.token.token = store_text(m_spelling.data(), m_spelling.size());
+	    text.token.type = strings;
+	    text.token.id = 0;
+	    text.token.location = no_location;
+	    text.hide_set = 0;
+	    text.leading_space = false;
+	    text.from_source = false;
+
+	    return text;
+	}
+
+	bool macro_expander::paste(expanded_token &left, const expanded_token &right)
+	{
+	    m_spelling = left.token.token;
+	    m_spelling += right.token.token;
+
+	    string_view text = store_text(m_spelling.data(), m_spelling.size());
+
+	    m_pasted.clear();
+	    preprocessor_tokenizer::tokenize_string(text.data(), text.size(), m_pasted);
+
+	    const vector<preprocessor_token> &tokens = m_pasted.get_tokens();
+
+	    if(tokens.empty() || tokens[0].token.size() != text.size() || tokens[0].type == comment || tokens[0].type == multi_comment)
+	    {
+	        return false;
+	    }
+
+	    left.token.token = tokens[0].token;
+	    left.token.type = tokens[0].type;
+	    left.token.id = tokens[0].id;
+
+	    return true;
+	}
+
+	string_view macro_expander::store_text(const char *text, size_t size)
+	{
+	    if(size > text_block_size)
+	    {
+	        m_large_texts.push_back(string(text, size));
+
+	        return m_large_texts.back();
+	    }
+
+	    if(m_text_blocks.empty() || m_text_used + size > text_block_size)
+	    {
+	        if(!m_text_blocks.empty())
+	        {
+	            m_text_block++;
+	        }
+
+	        if(m_text_block == m_text_blocks.size())
+	        {
+	            m_text_blocks.push_back(unique_ptr<char[]>(new char[text_block_size]));
+	        }
+
+	        m_text_used = 0;
+	    }
+
+	    char *stored = m_text_blocks[m_text_block].get() + m_text_used;
+
+	    memcpy(stored, text, size);
+	    m_text_used += size;
+
+	    return string_view(stored, size);
+	}
+
+	bool macro_expander::hide_set_contains(unsigned int hide_set, atom name) const
+	{
+	    while(hide_set)
+	    {
+	        if(m_hide_sets[hide_set].name == name)
+	        {
+	            return true;
+	        }
+
+	        hide_set = m_hide_sets[hide_set].next;
+	    }
+
+	    return false;
+	}
+
+	unsigned int macro_expander::hide_set_add(unsigned int hide_set, atom name)
+	{
+	    if(hide_set_contains(hide_set, name))
+	    {
+	        return hide_set;
+	    }
+
+	    //Sets are shared so the same additions always give the same node
+	    unsigned long long key = (static_cast<unsigned long long>(hide_set) << 32) | name;
+	    unordered_map<unsigned long long, unsigned int>::const_iterator found = m_hide_set_index.find(key);
+
+	    if(found != m_hide_set_index.end())
+	    {
+	        return found->second;
+	    }
+
+	    hide_set_node node = { name, hide_set };
+
+	    m_hide_sets.push_back(node);
+	    m_hide_set_index[key] = m_hide_sets.size() - 1;
+
+	    return m_hide_sets.size() - 1;
+	}
+
+	unsigned int macro_expander::hide_set_union(unsigned int first, unsigned int second)
+	{
+	    if(!first)
+	    {
+	        return second;
+	    }
+
+	    for(; second; second = m_hide_sets[second].next)
+	    {
+	        first = hide_set_add(first, m_hide_sets[second].name);
+	    }
+
+	    return first;
+	}
+
+	unsigned int macro_expander::hide_set_intersection(unsigned int first, unsigned int second)
+	{
+	    if(first == second)
+	    {
+	        return first;
+	    }
+
+	    unsigned int result = 0;
+
+	    for(; first; first = m_hide_sets[first].next)
+	    {
+	        if(hide_set_contains(second, m_hide_sets[first].name))
+	        {
+	            result = hide_set_add(result, m_hide_sets[first].name);
+	        }
+	    }
+
+	    return result;
+	}
+}
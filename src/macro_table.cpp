@@ -0,0 +1,232 @@
+#include <cstring>
+#include "macro_table.hpp"
+#include "preprocessor_tokenizer.hpp"
+#include "tokenized_file.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        const size_t token_block_size = 4096;
+        const size_t text_block_size = 64 * 1024;
+
+        /**
+         * Checks if two definitions are the same (redefinitions allowed by the standard)
+         */
+        inline bool same_definition(const define &first, const define &second)
+        {
+            return first.type == second.type && first.value == second.value
+                && first.parameters == second.parameters && first.variadic == second.variadic;
+        }
+    }
+
+	vector<define> macro_table::get_defines(file_scope scope) const
+	{
+	    vector<define> defines;
+
+	    for(size_t i=0; i<m_slots.size(); i++)
+	    {
+	        if(m_slots[i].used && m_slots[i].scope == scope)
+	        {
+	            defines.push_back(m_slots[i].definition);
+	        }
+	    }
+
+	    return defines;
+	}
+
+	macro_handle macro_table::add(const define &definition, file_scope scope)
+	{
+	    //Definitions that don't come from the sources only have the value
+	    tokenized_file lexed;
+
+	    preprocessor_tokenizer::tokenize_string(definition.value.data(), definition.value.size(), lexed);
+
+	    const vector<preprocessor_token> &tokens = lexed.get_tokens();
+
+	    return add(definition, token_span(tokens.data(), tokens.data() + tokens.size()), scope);
+	}
+
+	macro_handle macro_table::add(const define &definition, token_span replacement, file_scope scope)
+	{
+	    atom name = atom_table::intern(definition.name);
+	    macro_handle handle = find(name);
+
+	    if(handle == no_macro)
+	    {
+	        if(!m_free_slots.empty())
+	        {
+	            handle = m_free_slots.back();
+	            m_free_slots.pop_back();
+	        }
+	        else
+	        {
+	            handle = m_slots.size();
+	            m_slots.push_back(macro_slot());
+	        }
+
+	        if(name >= m_index.size())
+	        {
+	            m_index.resize(name + 1, no_macro);
+	        }
+
+	        m_index[name] = handle;
+	        m_count++;
+	    }
+	    else if(same_definition(m_slots[handle].definition, definition))
+	    {
+	        //Identical redefinitions keep the stored replacement list
+	        m_slots[handle].scope = scope;
+
+	        return handle;
+	    }
+
+	    //Redefinitions replace the previous value keeping the same slot
+	    macro_slot &slot = m_slots[handle];
+
+	    slot.definition = definition;
+	    slot.definition.name_atom = name;
+	    slot.scope = scope;
+	    slot.used = true;
+
+	    store_replacement(slot.definition, replacement);
+
+	    return handle;
+	}
+
+	bool macro_table::remove(atom name)
+	{
+	    macro_handle handle = find(name);
+
+	    if(handle == no_macro)
+	    {
+	        return false;
+	    }
+
+	    m_index[name] = no_macro;
+	    m_count--;
+
+	    macro_slot &slot = m_slots[handle];
+
+	    slot.definition = define();
+	    slot.used = false;
+
+	    m_free_slots.push_back(handle);
+
+	    return true;
+	}
+
+	void macro_table::clear(file_scope scope)
+	{
+	    for(size_t i=0; i<m_slots.size(); i++)
+	    {
+	        if(m_slots[i].used && m_slots[i].scope == scope)
+	        {
+	            remove(m_slots[i].definition.name_atom);
+	        }
+	    }
+	}
+
+	replacement_token* macro_table::allocate_tokens(size_t count)
+	{
+	    if(count > m_token_left)
+	    {
+	        //The rest of the last block is wasted, lists bigger than a block get their own
+	        size_t size = count > token_block_size ? count : token_block_size;
+
+	        m_token_blocks.push_back(unique_ptr<replacement_token[]>(new replacement_token[size]));
+	        m_token_next = m_token_blocks.back().get();
+	        m_token_left = size;
+	    }
+
+	    replacement_token *tokens = m_token_next;
+
+	    m_token_next += count;
+	    m_token_left -= count;
+
+	    return tokens;
+	}
+
+	string_view macro_table::store_text(string_view text)
+	{
+	    if(text.size() > m_text_left)
+	    {
+	        size_t size = text.size() > text_block_size ? text.size() : text_block_size;
+
+	        m_text_blocks.push_back(unique_ptr<char[]>(new char[size]));
+	        m_text_next = m_text_blocks.back().get();
+	        m_text_left = size;
+	    }
+
+	    char *stored = m_text_next;
+
+	    memcpy(stored, text.data(), text.size());
+	    m_text_next += text.size();
+	    m_text_left -= text.size();
+
+	    return string_view(stored, text.size());
+	}
+
+	void macro_table::store_replacement(define &definition, token_span tokens)
+	{
+	    size_t count = 0;
+
+	    for(size_t i=0; i<tokens.size(); i++)
+	    {
+	        if(tokens[i].type != comment && tokens[i].type != multi_comment && tokens[i].type != new_line && tokens[i].token != "\\")
+	        {
+	            count++;
+	        }
+	    }
+
+	    vector<atom> parameters(definition.parameters.size());
+
+	    for(size_t i=0; i<parameters.size(); i++)
+	    {
+	        parameters[i] = atom_table::intern(definition.parameters[i]);
+	    }
+
+	    replacement_token *replacement = allocate_tokens(count);
+	    const char *previous_end = 0;
+	    bool space = false;
+	    size_t stored = 0;
+
+	    for(size_t i=0; i<tokens.size(); i++)
+	    {
+	        const preprocessor_token &token = tokens[i];
+
+	        if(token.type == comment || token.type == multi_comment || token.type == new_line || token.token == "\\")
+	        {
+	            space = true;
+	            continue;
+	        }
+
+	        replacement_token &copy = replacement[stored++];
+
+	        copy.token = token;
+	        copy.token.token = store_text(token.token);
+	        copy.parameter = -1;
+	        copy.leading_space = space || (previous_end && token.token.data() != previous_end);
+
+	        if(token.type == identifier && definition.type == function)
+	        {
+	            for(size_t p=0; p<parameters.size(); p++)
+	            {
+	                if(parameters[p] == token.id)
+	                {
+	                    copy.parameter = p;
+	                    break;
+	                }
+	            }
+	        }
+
+	        previous_end = token.token.data() + token.token.size();
+	        space = false;
+	    }
+
+	    definition.replacement = replacement;
+	    definition.replacement_size = count;
+	}
+}
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include <string>
+#include <sys/stat.h>
 #include "version.h"
 #include "misc.hpp"
 
@@ -9,17 +10,34 @@ namespace cpp_parser
 {
 	bool file_exists(const string &file)
 	{
-		FILE* fp = fopen(file.c_str(), "r");
+	    struct stat file_status;
 
-		if(!fp)
+		if(stat(file.c_str(), &file_status) != 0)
 		{
 			return false;
 		}
 
-		return true;
+		return !S_ISDIR(file_status.st_mode);
 	}
 
-	unsigned int count_character(const char &character, string &source)
+	bool get_file_stamp(const string &file, file_stamp &stamp)
+	{
+	    struct stat file_status;
+
+	    if(stat(file.c_str(), &file_status) != 0)
+	    {
+	        return false;
+	    }
+
+	    stamp.identity.device = file_status.st_dev;
+	    stamp.identity.inode = file_status.st_ino;
+	    stamp.modified = file_status.st_mtim.tv_sec * 1000000000LL + file_status.st_mtim.tv_nsec;
+	    stamp.size = file_status.st_size;
+
+	    return true;
+	}
+
+	unsigned int count_character(const char &character, string_view source)
 	{
 	    unsigned int count = 0;
 	    for(unsigned int i=0; i<source.size(); i++)
@@ -0,0 +1,31 @@
+#include <cerrno>
+#include <unistd.h>
+#include "output_sink.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+	void fd_sink::drain(const char *data, size_t size)
+	{
+	    while(size > 0 && !m_failed)
+	    {
+	        ssize_t written = ::write(m_descriptor, data, size);
+
+	        if(written < 0)
+	        {
+	            if(errno == EINTR)
+	            {
+	                continue;
+	            }
+
+	            m_failed = true;
+	        }
+	        else
+	        {
+	            data += written;
+	            size -= written;
+	        }
+	    }
+	}
+}
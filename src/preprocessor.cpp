@@ -1,89 +1,157 @@
-#include <map>
+#include <algorithm>
+#include <memory>
 #include <cctype>
-#include <iostream>
+#include <cstring>
+#include "atom_table.hpp"
 #include "misc.hpp"
 #include "types.hpp"
 #include "preprocessor.hpp"
 #include "preprocessor_tokenizer.hpp"
+#include "condition_cache.hpp"
+#include "source_buffer.hpp"
 #include "constexpr.hpp"
 
 using namespace std;
 
 namespace cpp_parser
 {
+    namespace
+    {
+        const unsigned int max_include_depth = 200;
+
+        /**
+         * Checks if a token is only white space for a directive, including the \\ of continued lines
+         */
+        inline bool is_blank(const preprocessor_token &token)
+        {
+            return token.type == comment || token.type == multi_comment || token.type == new_line || token.token == "\\";
+        }
+
+        /**
+         * Checks if a byte can be part of the indentation of a line
+         */
+        inline bool is_indentation(char byte)
+        {
+            return byte == ' ' || byte == '\t' || byte == '\f' || byte == '\v';
+        }
+    }
+
 	preprocessor::~preprocessor()
 	{
 	}
 
-	vector<preprocessor_token> preprocessor::strip_macro_definition(const vector<preprocessor_token> &definition_declaration)
+	void preprocessor::set_global_defines(const vector<define> &global_defines)
+	{
+	    m_macros.clear(global);
+
+	    for(unsigned int i=0; i<global_defines.size(); i++)
+	    {
+	        m_macros.add(global_defines[i], global);
+	    }
+	}
+
+	bool preprocessor::is_continued(token_span directive)
 	{
-	    vector<preprocessor_token> new_copy = definition_declaration;
+	    size_t last = directive.size();
 
-	    new_copy.erase(new_copy.begin(), new_copy.begin() + 2);
+	    if(last > 0 && directive[last - 1].type == new_line)
+	    {
+	        last--;
+	    }
 
-	    return new_copy;
+	    return last > 0 && directive[last - 1].token == "\\";
 	}
 
-	const define preprocessor::parse_define(const vector<preprocessor_token> &define_declaration)
+	token_span preprocessor::strip_macro_definition(token_span definition_declaration)
 	{
-		int declaration_size = define_declaration.size();
+	    return definition_declaration.subspan(2);
+	}
 
-		bool getting_name = true;
-		bool parsing_parameters = false;
-		bool getting_value = false;
+	const define preprocessor::parse_define(token_span define_declaration, token_span &replacement)
+	{
+		unsigned int declaration_size = define_declaration.size();
 
 		string name = "";
 		string value = "";
 		vector<string> parameters;
+		bool function_like = false;
+		bool variadic = false;
+		unsigned int i = 0;
 
-		for(int i=0; i<declaration_size; i++)
+		if(declaration_size > 0)
 		{
-			if(getting_name)
-			{
-                name = define_declaration[i].token;
-                getting_name = false;
+		    name = define_declaration[0].token;
+		    i = 1;
 
-                if(define_declaration[i+1].token == "(")
-                {
-                    i++;
-                    parsing_parameters = true;
-                }
-                else
-                {
-                    getting_value = true;
-                }
-			}
-			else if(parsing_parameters)
-			{
-                if(define_declaration[i].token != "," && define_declaration[i].token != ")")
-                {
-                    parameters.push_back(define_declaration[i].token);
-                }
-                else if(define_declaration[i].token == ")")
-                {
-                    parsing_parameters = false;
-                    getting_value = true;
-                }
-			}
-			else if(getting_value)
-			{
-			    if(define_declaration[i].token == "\\")
-			    {
-			        value += "\n";
-			    }
-			    else
-			    {
-			        value += define_declaration[i].token;
-			    }
-			}
+		    //Only a ( right after the name, without spaces, starts the parameters
+		    function_like = declaration_size > 1 && define_declaration[1].token == "("
+		        && define_declaration[1].token.data() == define_declaration[0].token.data() + define_declaration[0].token.size();
+		}
+
+		if(function_like)
+		{
+		    for(i=2; i<declaration_size; i++)
+		    {
+		        string_view token = define_declaration[i].token;
+
+		        if(token == ")")
+		        {
+		            i++;
+		            break;
+		        }
+		        else if(token == "...")
+		        {
+		            //Named variadic parameters (args...) keep their name
+		            if(define_declaration[i - 1].type != identifier)
+		            {
+		                parameters.push_back("__VA_ARGS__");
+		            }
+
+		            variadic = true;
+		        }
+		        else if(define_declaration[i].type == identifier)
+		        {
+		            parameters.push_back(string(token));
+		        }
+		    }
+		}
+
+		replacement = define_declaration.subspan(i);
+
+		//Tokens separated on the source keep a space between them so the value can be tokenized again
+		const char *previous_end = 0;
+
+		for(; i<declaration_size; i++)
+		{
+		    const preprocessor_token &token = define_declaration[i];
+
+		    if(token.type == new_line || token.token == "\\")
+		    {
+		        continue;
+		    }
+
+		    if(!value.empty() && previous_end != token.token.data())
+		    {
+		        value += " ";
+		    }
+
+		    value += token.token;
+
+		    previous_end = token.token.data() + token.token.size();
 		}
 
 		define define_structure;
+		define_structure.file = no_atom;
+		define_structure.line = 0;
+		define_structure.column = 0;
 		define_structure.name = name;
 		define_structure.value = value;
 		define_structure.parameters = parameters;
+		define_structure.variadic = variadic;
+		define_structure.replacement = 0;
+		define_structure.replacement_size = 0;
 
-		if(parameters.size() > 0)
+		if(function_like)
 		{
 			define_structure.type = function;
 		}
@@ -95,554 +163,973 @@ namespace cpp_parser
 		return define_structure;
 	}
 
-    // TODO (jgm#1#): Fully Implement this function
-	const bool preprocessor::parse_expression(const vector<preprocessor_token> &expression)
+    // TODO (jgm#1#): Fully Implement this function
+	const bool preprocessor::parse_expression(const directive_context &context)
 	{
-	    bool return_value = false;
+	    token_span expression = strip_macro_definition(context.tokens);
 
-	    const vector<Token> tokens_vector = expand_macro_expression(expression);
+	    //Most conditions only use defined and macros with numeric values, they run from the cache
+	    const compiled_condition &condition = condition_cache::get(context.file_atom, context.offset, expression);
+	    integer_literal value;
 
-        Token tokens[tokens_vector.size()];
+	    if(condition_cache::evaluate(condition, m_macros, value))
+	    {
+	        return value.value != 0;
+	    }
 
-	    for(unsigned int i=0; i<tokens_vector.size(); i++)
-        {
-            tokens[i] = tokens_vector[i];
-        }
+	    const vector<ExprToken> &tokens = expand_macro_expression(expression);
 
-        try
-        {
-            PCToken pcToken = &tokens[0];
+	    if(ConstExprEvaluator::eval(tokens.data(), tokens.size(), m_expression_result))
+	    {
+	        return m_expression_result.value.value != 0;
+	    }
 
-            if(ConstExprEvaluator::eval(&pcToken) > 0)
-            {
-                return_value = true;
-            }
-        }
-        catch (const PreprocessorError &prepError)
-        {
-            return_value = false;
-
-            //TODO add this exception to m_error
-            std::cerr << "Exception: " << prepError.getMessage() << "\n";
-        }
+	    add_error(context, m_expression_result.message, context.tokens[0].location);
 
-        return return_value;
+	    return false;
 	}
 
-	void preprocessor::add_error(const std::vector<preprocessor_token> &error_declaration, const string& file)
+	void preprocessor::add_error(const directive_context &context, const string &message, source_location location)
 	{
-        string error_message;
-        unsigned int line;
-
-        //Copy error message
-        for(unsigned int i=2; i<error_declaration.size(); i++)
-        {
-            error_message += error_declaration[i].token + " ";
-        }
-
-        line = error_declaration[0].line;
+	    preprocessor_error error_struct = {message, context.presumed_file.empty() ? context.file : context.presumed_file, source_manager::get_line(location) + context.line_delta};
 
-        preprocessor_error error_struct = {error_message, file, line};
-
-        m_errors.push_back(error_struct);
+	    m_errors.push_back(error_struct);
 	}
 
-	const vector<Token> preprocessor::expand_macro_expression(const vector<preprocessor_token> &expression)
+	const vector<ExprToken>& preprocessor::expand_macro_expression(token_span expression)
 	{
-	    vector<Token> tokens;
-	    Token space = { ttWhiteSpace, " " };
+	    static const atom defined_atom = atom_table::intern("defined");
+
+	    m_expression_tokens.clear();
+
+	    //The operand of defined must not be expanded so it is replaced by 1 or 0 first
+	    m_condition_tokens.clear();
 
 	    for(unsigned int i=0; i<expression.size(); i++)
+	    {
+	        if(expression[i].type == identifier && expression[i].id == defined_atom)
+	        {
+	            unsigned int name = i + 1;
+	            bool parenthesis = name < expression.size() && expression[name].token == "(";
+
+	            if(parenthesis)
+	            {
+	                name++;
+	            }
+
+	            if(name < expression.size() && expression[name].type == identifier)
+	            {
+	                preprocessor_token value = expression[name];
+
+	                value.token = is_defined(expression[name].id) ? "1" : "0";
+	                value.type = number;
+	                value.id = 0;
+
+	                m_condition_tokens.push_back(value);
+
+	                i = name;
+
+	                if(parenthesis && i + 1 < expression.size() && expression[i + 1].token == ")")
+	                {
+	                    i++;
+	                }
+
+	                continue;
+	            }
+	        }
+
+	        m_condition_tokens.push_back(expression[i]);
+	    }
+
+	    const vector<expanded_token> &expanded = m_expander.expand(token_span(m_condition_tokens.data(), m_condition_tokens.data() + m_condition_tokens.size()));
+
+	    for(unsigned int i=0; i<expanded.size(); i++)
         {
-            Token token_to_add;
+            const preprocessor_token &token = expanded[i].token;
+            ExprToken token_to_add = { ttNumber, { 0, false }, token.token };
 
-            if(expression[i].token == "defined")
-            {
-                //No need to manually evaluate so skip it
-                continue;
-            }
-            else if(expression[i].type == identifier)
+            //Identifiers left after expanding are not macros so they are 0
+            if(token.type == identifier)
             {
-                token_to_add.type = ttNumber;
+                keyword_type keyword = preprocessor_tokenizer::get_keyword_type(token.id);
 
-                if(is_defined(expression[i].token))
+                if(keyword == keyword_true)
                 {
-                    define macro = get_define(expression[i].token);
-
-                    //For macro definitions
-                    if(macro.parameters.size() <= 0)
-                    {
-                        if(macro.value == "")
-                        {
-                            //The macro is defined but without a predifined value for it so we default to 1
-                            token_to_add.value = "1";
-                        }
-                        else
-                        {
-                            //Tha macro has a predifined value (We should check if it's a valid number)
-                            token_to_add.value = macro.value;
-                        }
-                    }
-
-                    //For macro functions, we need to parse the parameters and then evaluate with recursive function
-                    else
-                    {
-                        //for now we just return 1 but this is totally wrong
-                        token_to_add.value = "1";
-                    }
+                    token_to_add.type = ttTrue;
+                }
+                else if(keyword == keyword_false)
+                {
+                    token_to_add.type = ttFalse;
                 }
                 else
                 {
-                    token_to_add.value = "0";
+                    token_to_add.type = ttNumber;
+                }
+            }
+
+            //Adds any numbers found, most were already decoded by the tokenizer
+            else if(token.type == number)
+            {
+                if(!preprocessor_tokenizer::get_literal(token, token_to_add.value))
+                {
+                    //Floating literals are not valid, the evaluator stops at them reporting the error
+                    token_to_add.type = ttEndOfTokens;
                 }
             }
 
-            //Adds any numbers found
-            else if(expression[i].type == number)
+            //Character literals are numbers too
+            else if(token.type == strings && token.token.back() == '\'')
             {
-                token_to_add.type = ttNumber;
-                token_to_add.value = expression[i].token;
+                token_to_add.type = ttCharLiteral;
+                preprocessor_tokenizer::get_literal(token, token_to_add.value);
             }
 
-            //Handle any other operator found
+            //Handle any other operator found by its punctuator kind
             else
             {
-                if(expression[i].token == "?")
-                {
-                    token_to_add.type = ttQuestion;
-                    token_to_add.value = "?";
-                }
-                else if(expression[i].token == ":")
-                {
-                    token_to_add.type = ttColon;
-                    token_to_add.value = ":";
-                }
-                else if(expression[i].token == "||")
-                {
-                    token_to_add.type = ttOr;
-                    token_to_add.value = "||";
-                }
-                else if(expression[i].token == "&&")
-                {
-                    token_to_add.type = ttAnd;
-                    token_to_add.value = "&&";
-                }
-                else if(expression[i].token == "|")
-                {
-                    token_to_add.type = ttBitOr;
-                    token_to_add.value = "|";
-                }
-                else if(expression[i].token == "^")
-                {
-                    token_to_add.type = ttBitXOr;
-                    token_to_add.value = "^";
-                }
-                else if(expression[i].token == "&")
-                {
-                    token_to_add.type = ttBitAnd;
-                    token_to_add.value = "&";
-                }
-                else if(expression[i].token == "==")
-                {
-                    token_to_add.type = ttEqual;
-                    token_to_add.value = "==";
-                }
-                else if(expression[i].token == "!=")
-                {
-                    token_to_add.type = ttNotEqual;
-                    token_to_add.value = "!=";
-                }
-                else if(expression[i].token == "<")
-                {
-                    token_to_add.type = ttLess;
-                    token_to_add.value = "<";
-                }
-                else if(expression[i].token == ">")
-                {
-                    token_to_add.type = ttGreater;
-                    token_to_add.value = ">";
-                }
-                else if(expression[i].token == "<=")
-                {
-                    token_to_add.type = ttLessEqual;
-                    token_to_add.value = "<=";
-                }
-                else if(expression[i].token == ">=")
-                {
-                    token_to_add.type = ttGreaterEqual;
-                    token_to_add.value = ">=";
-                }
-                else if(expression[i].token == "<<")
-                {
-                    token_to_add.type = ttLShift;
-                    token_to_add.value = "<<";
-                }
-                else if(expression[i].token == ">>")
-                {
-                    token_to_add.type = ttRShift;
-                    token_to_add.value = ">>";
-                }
-                else if(expression[i].token == "+")
-                {
-                    token_to_add.type = ttPlus;
-                    token_to_add.value = "+";
-                }
-                else if(expression[i].token == "-")
-                {
-                    token_to_add.type = ttMinus;
-                    token_to_add.value = "-";
-                }
-                else if(expression[i].token == "*")
-                {
-                    token_to_add.type = ttTimes;
-                    token_to_add.value = "*";
-                }
-                else if(expression[i].token == "/")
-                {
-                    token_to_add.type = ttDivide;
-                    token_to_add.value = "/";
-                }
-                else if(expression[i].token == "%")
-                {
-                    token_to_add.type = ttModulo;
-                    token_to_add.value = "%";
-                }
-                else if(expression[i].token == "!")
-                {
-                    token_to_add.type = ttNot;
-                    token_to_add.value = "?";
-                }
-                else if(expression[i].token == "~")
-                {
-                    token_to_add.type = ttBitNeg;
-                    token_to_add.value = "~";
-                }
-                else if(expression[i].token == "(")
-                {
-                    token_to_add.type = ttLParen;
-                    token_to_add.value = "(";
-                }
-                else if(expression[i].token == ")")
+                switch(token.id)
                 {
-                    token_to_add.type = ttRParen;
-                    token_to_add.value = ")";
+                    case punctuator_question:
+                        token_to_add.type = ttQuestion;
+                        break;
+                    case punctuator_colon:
+                        token_to_add.type = ttColon;
+                        break;
+                    case punctuator_pipe_pipe:
+                        token_to_add.type = ttOr;
+                        break;
+                    case punctuator_ampersand_ampersand:
+                        token_to_add.type = ttAnd;
+                        break;
+                    case punctuator_pipe:
+                        token_to_add.type = ttBitOr;
+                        break;
+                    case punctuator_caret:
+                        token_to_add.type = ttBitXOr;
+                        break;
+                    case punctuator_ampersand:
+                        token_to_add.type = ttBitAnd;
+                        break;
+                    case punctuator_equal_equal:
+                        token_to_add.type = ttEqual;
+                        break;
+                    case punctuator_exclaim_equal:
+                        token_to_add.type = ttNotEqual;
+                        break;
+                    case punctuator_less:
+                        token_to_add.type = ttLess;
+                        break;
+                    case punctuator_greater:
+                        token_to_add.type = ttGreater;
+                        break;
+                    case punctuator_less_equal:
+                        token_to_add.type = ttLessEqual;
+                        break;
+                    case punctuator_greater_equal:
+                        token_to_add.type = ttGreaterEqual;
+                        break;
+                    case punctuator_less_less:
+                        token_to_add.type = ttLShift;
+                        break;
+                    case punctuator_greater_greater:
+                        token_to_add.type = ttRShift;
+                        break;
+                    case punctuator_plus:
+                        token_to_add.type = ttPlus;
+                        break;
+                    case punctuator_minus:
+                        token_to_add.type = ttMinus;
+                        break;
+                    case punctuator_star:
+                        token_to_add.type = ttTimes;
+                        break;
+                    case punctuator_slash:
+                        token_to_add.type = ttDivide;
+                        break;
+                    case punctuator_percent:
+                        token_to_add.type = ttModulo;
+                        break;
+                    case punctuator_exclaim:
+                        token_to_add.type = ttNot;
+                        break;
+                    case punctuator_tilde:
+                        token_to_add.type = ttBitNeg;
+                        break;
+                    case punctuator_left_parenthesis:
+                        token_to_add.type = ttLParen;
+                        break;
+                    case punctuator_right_parenthesis:
+                        token_to_add.type = ttRParen;
+                        break;
+                    case punctuator_comma:
+                        token_to_add.type = ttComma;
+                        break;
+                    default: //Strings, comments and anything else are ignored
+                        continue;
                 }
             }
 
-            if(token_to_add.value != "")
-                tokens.push_back(token_to_add);
+            m_expression_tokens.push_back(token_to_add);
         }
 
-        Token endToken = {ttEndOfTokens, ""};
-        tokens.push_back(endToken);
+        return m_expression_tokens;
+	}
 
+	bool preprocessor::has_macros(token_span line) const
+	{
+	    for(unsigned int i=0; i<line.size(); i++)
+	    {
+	        if(line[i].type == identifier && m_macros.find(line[i].id) != no_macro)
+	        {
+	            return true;
+	        }
+	    }
 
-        return tokens;
+	    return false;
 	}
 
-	const define preprocessor::get_define(const string &definition)
+	void preprocessor::write_source_line(token_span line, const source_buffer &source, output_sink &output)
 	{
-		//First check in global definitions
-		unsigned int global_definitions_count = m_global_defines.size();
+	    size_t last = line.size();
 
-		for(unsigned int i=0; i<global_definitions_count; i++)
-		{
-			if(definition == m_global_defines.at(i).name)
-			{
-				return m_global_defines.at(i);
-			}
-		}
+	    while(last > 0 && line[last - 1].type == new_line)
+	    {
+	        last--;
+	    }
 
-		//Secondly check in definitions added while parsing
-		unsigned int local_definitions_count = m_local_defines.size();
+	    if(last > 0)
+	    {
+	        const char *begin = line[0].token.data();
+	        const char *end = line[last - 1].token.data() + line[last - 1].token.size();
 
-		for(unsigned int i=0; i<local_definitions_count; i++)
-		{
-			if(definition == m_local_defines.at(i).name)
-			{
-				return m_local_defines.at(i);
-			}
-		}
+	        //The indentation is copied too
+	        while(begin > source.data() && is_indentation(begin[-1]))
+	        {
+	            begin--;
+	        }
 
-		return define();
+	        output.write(begin, end - begin);
+	    }
+
+	    output.put('\n');
 	}
 
-	const string preprocessor::parse_file(const string &file, file_scope scope)
+	source_location preprocessor::line_start(token_span line, const source_buffer &source, source_location base)
 	{
-	    string full_file_path = file_path(file, scope);
+	    if(line.empty() || line[0].location == no_location)
+	    {
+	        return no_location;
+	    }
+
+	    const char *begin = source.data() + (line[0].location - base);
+	    const char *indentation = begin;
 
-	    if(!file_exists(full_file_path))
+	    while(indentation > source.data() && is_indentation(indentation[-1]))
 	    {
-	        return string();
+	        indentation--;
 	    }
 
-        unsigned int deepness = 0;
-        map<unsigned int, bool> last_condition_return;
-        string output;
+	    return line[0].location - (begin - indentation);
+	}
 
-        vector< vector<preprocessor_token> > lines = preprocessor_tokenizer::tokenize_file(full_file_path);
+	bool preprocessor::is_blank_line(token_span line)
+	{
+	    for(unsigned int i=0; i<line.size(); i++)
+	    {
+	        if(!is_blank(line[i]))
+	        {
+	            return false;
+	        }
+	    }
 
-        for(unsigned int position=0; position<lines.size(); position++)
-        {
-            vector<preprocessor_token> tokens = lines[position];
+	    return true;
+	}
 
-            //Parse macro
-            if(tokens[0].token == "#")
-            {
-                if(deepness == 0 || (deepness > 0 && last_condition_return[deepness]))
-                {
-                    if(tokens[1].token == "define")
-                    {
-                        define definition = parse_define(strip_macro_definition(tokens));
-                        definition.file = file;
-                        definition.line = tokens[2].line;
-                        definition.column = tokens[2].column;
-                        m_local_defines.push_back(definition);
-                    }
-                    if(tokens[1].token == "include")
-                    {
-                        string include_enclosure = tokens[2].token;
-                        string include_file = "";
-                        file_scope header_scope;
+	atom preprocessor::guard_macro(token_span directive, directive_type type)
+	{
+	    static const atom defined_atom = atom_table::intern("defined");
 
-                        if(include_enclosure == "<")
-                        {
-                            for(unsigned int i=3; i<tokens.size(); i++)
-                            {
-                                if(tokens[i].token == ">")
-                                {
-                                    break;
-                                }
-                                else
-                                {
-                                    include_file += tokens[i].token;
-                                }
-                            }
+	    const preprocessor_token *operands[5];
+	    unsigned int count = 0;
 
-                            m_headers_scope[include_file] = global;
-                            header_scope = global;
-                        }
-                        else if(include_enclosure[0] == '"')
-                        {
-                            for(unsigned int i=1; i<tokens[2].token.size(); i++)
-                            {
-                                if(tokens[2].token.at(i) == '"')
-                                {
-                                    break;
-                                }
-                                else
-                                {
-                                    include_file += tokens[2].token.at(i);
-                                }
-                            }
+	    for(unsigned int i=2; i<directive.size(); i++)
+	    {
+	        if(is_blank(directive[i]))
+	        {
+	            continue;
+	        }
 
-                            m_headers_scope[include_file] = local;
-                            header_scope = local;
-                        }
-                        else
-                        {
+	        if(count == 5)
+	        {
+	            return no_atom;
+	        }
 
-                        }
+	        operands[count++] = &directive[i];
+	    }
 
-                        if(!is_header_parsed(include_file))
-                        {
-                            output += parse_file(include_file, header_scope); //To output the processed headers code
-                            //parse_file(include_file, header_scope);
+	    if(type == directive_ifndef)
+	    {
+	        return count == 1 && operands[0]->type == identifier ? operands[0]->id : no_atom;
+	    }
 
-                            m_headers.push_back(include_file);
-                        }
-                    }
-                    else if(tokens[1].token == "undef")
-                    {
-                        remove_define(tokens[2].token);
-                    }
-                    else if(tokens[1].token == "ifdef")
-                    {
-                        deepness++;
-                        if(is_defined(tokens[2].token))
-                        {
-                            last_condition_return[deepness] = true;
-                        }
-                        else
-                        {
-                            last_condition_return[deepness] = false;
-                        }
-                    }
-                    else if(tokens[1].token == "ifndef")
-                    {
-                        deepness++;
-                        if(!is_defined(tokens[2].token))
-                        {
-                            last_condition_return[deepness] = true;
-                        }
-                        else
-                        {
-                            last_condition_return[deepness] = false;
-                        }
-                    }
-                    else if(tokens[1].token == "if")
-                    {
-                        deepness++;
-                        last_condition_return[deepness] = parse_expression(strip_macro_definition(tokens));
-                    }
-                    else if(tokens[1].token == "error")
-                    {
-                        add_error(tokens, file);
-                    }
-                }
+	    //#if !defined X or #if !defined(X)
+	    if(type != directive_if || count < 3 || operands[0]->token != "!" || operands[1]->type != identifier || operands[1]->id != defined_atom)
+	    {
+	        return no_atom;
+	    }
 
-                if(deepness > 0 && (tokens[1].token == "elif" || tokens[1].token == "else" || tokens[1].token == "endif"))
-                {
-                    if(tokens[1].token == "elif" && last_condition_return[deepness] != true)
-                    {
-                        last_condition_return[deepness] = parse_expression(strip_macro_definition(tokens));
-                    }
-                    else if(tokens[1].token == "else" && last_condition_return[deepness] != true)
-                    {
-                        last_condition_return[deepness] = true;
-                    }
-                    else if(tokens[1].token == "endif")
-                    {
-                        last_condition_return.erase(last_condition_return.find(deepness));
-                        deepness--;
-                    }
-                }
-            }
+	    if(count == 3 && operands[2]->type == identifier)
+	    {
+	        return operands[2]->id;
+	    }
 
-            //Parse code
-            else
-            {
-                if(deepness == 0 || (deepness > 0 && last_condition_return[deepness]))
-                {
-                    unsigned int column = 1;
+	    if(count == 5 && operands[2]->token == "(" && operands[3]->type == identifier && operands[4]->token == ")")
+	    {
+	        return operands[3]->id;
+	    }
 
-                    for(unsigned int i=0; i<tokens.size(); i++)
-                    {
-                        unsigned int columns_to_jump = tokens[i].column - column;
+	    return no_atom;
+	}
 
-                        if(tokens[i].column <= 0)
-                        {
-                            columns_to_jump = 0;
-                        }
-                        else if(tokens[i].column < column)
-                        {
-                            columns_to_jump = column - tokens[i].column;
-                        }
+	bool preprocessor::is_guarded(const file_identity &identity) const
+	{
+	    unordered_map<file_identity, header_guard, file_identity_hash>::const_iterator guard = m_guards.find(identity);
 
-                        for(unsigned int y=0; y<columns_to_jump; y++)
-                        {
-                            output += " ";
-                        }
+	    if(guard == m_guards.end())
+	    {
+	        return false;
+	    }
 
-                        if(tokens[i].type == identifier && is_defined(tokens[i].token))
-                        {
-                            output += get_define(tokens[i].token).value;
-                        }
-                        else
-                        {
-                            output += tokens[i].token;
-                        }
+	    return guard->second.once || (guard->second.macro != no_atom && is_defined(guard->second.macro));
+	}
 
-                        column = tokens[i].column + tokens[i].token.size();
-                    }
+	const preprocessor_token* preprocessor::directive_operand(token_span directive)
+	{
+	    for(unsigned int i=2; i<directive.size(); i++)
+	    {
+	        const preprocessor_token &token = directive[i];
 
-                    output += "\n";
-                }
-            }
-        }
+	        if(!is_blank(token))
+	        {
+	            return &token;
+	        }
+	    }
 
-		return output;
+	    return 0;
 	}
 
-	const bool preprocessor::is_defined(const string &definition)
+	const preprocessor_token* preprocessor::macro_name(const directive_context &context)
 	{
-		//First check in global definitions
-		unsigned int global_definitions_count = m_global_defines.size();
+	    const preprocessor_token *name = directive_operand(context.tokens);
 
-		for(unsigned int i=0; i<global_definitions_count; i++)
-		{
-			if(definition == m_global_defines.at(i).name)
-			{
-				return true;
-			}
-		}
+	    if(!name || name->type != identifier)
+	    {
+	        add_error(context, "Macro name missing on #" + string(context.tokens[1].token), context.tokens[0].location);
 
-		//Secondly check in definitions added while parsing
-		unsigned int local_definitions_count = m_local_defines.size();
+	        return 0;
+	    }
 
-		for(unsigned int i=0; i<local_definitions_count; i++)
-		{
-			if(definition == m_local_defines.at(i).name)
-			{
-				return true;
-			}
-		}
+	    return name;
+	}
+
+	void preprocessor::open_condition(const directive_context &context, bool taken)
+	{
+	    condition group = { taken ? condition_taking : condition_skipping, context.tokens[0].location };
+
+	    //No branch of a group inside of a skipped one can be taken
+	    if(!is_active())
+	    {
+	        group.state = condition_taken;
+	    }
+
+	    m_conditions.push_back(group);
+	}
+
+	bool preprocessor::next_branch(const directive_context &context)
+	{
+	    if(m_conditions.size() <= context.conditions_base)
+	    {
+	        add_error(context, "#" + string(context.tokens[1].token) + " without #if", context.tokens[0].location);
+
+	        return false;
+	    }
+
+	    condition &group = m_conditions.back();
+
+	    if(group.state == condition_taking)
+	    {
+	        group.state = condition_taken;
+	    }
+
+	    return group.state == condition_skipping;
+	}
+
+	//The handlers are in the same order as directive_type
+	const preprocessor::directive_entry preprocessor::m_directives[directive_count] =
+	{
+	    { 0, false },                                   //no_directive
+	    { &preprocessor::handle_define, false },
+	    { &preprocessor::handle_undef, false },
+	    { &preprocessor::handle_include, false },
+	    { &preprocessor::handle_include_next, false },
+	    { &preprocessor::handle_include, false },       //import
+	    { &preprocessor::handle_if, true },
+	    { &preprocessor::handle_ifdef, true },
+	    { &preprocessor::handle_ifndef, true },
+	    { &preprocessor::handle_elif, true },
+	    { &preprocessor::handle_elifdef, true },
+	    { &preprocessor::handle_elifndef, true },
+	    { &preprocessor::handle_else, true },
+	    { &preprocessor::handle_endif, true },
+	    { &preprocessor::handle_error, false },
+	    { 0, false },                                   //warning
+	    { &preprocessor::handle_pragma, false },
+	    { &preprocessor::handle_line, false },
+	    { 0, false }                                    //ident
+	};
+
+	void preprocessor::handle_define(directive_context &context)
+	{
+	    token_span tokens = context.tokens;
+
+	    if(tokens.size() < 3 || tokens[2].type != identifier)
+	    {
+	        add_error(context, "Macro name missing on #define", tokens[0].location);
+
+	        return;
+	    }
+
+	    token_span replacement;
+	    define definition = parse_define(strip_macro_definition(tokens), replacement);
+	    resolved_location name;
+
+	    if(source_manager::resolve(tokens[2].location, name))
+	    {
+	        definition.file = atom_table::intern(context.presumed_file.empty() ? context.file : context.presumed_file);
+	        definition.line = name.line + context.line_delta;
+	        definition.column = name.column;
+	    }
+
+	    m_macros.add(definition, replacement, local);
+	}
+
+	void preprocessor::handle_undef(directive_context &context)
+	{
+	    const preprocessor_token *name = macro_name(context);
+
+	    if(name)
+	    {
+	        remove_define(name->token);
+	    }
+	}
 
+	void preprocessor::handle_include(directive_context &context)
+	{
+	    include_header(context, false);
+	}
 
-		return false;
+	void preprocessor::handle_include_next(directive_context &context)
+	{
+	    //Only the files found on the include directories have a next one to search, for the rest it is ignored
+	    if(context.search_directory != no_directory)
+	    {
+	        include_header(context, true);
+	    }
 	}
 
-	const bool preprocessor::remove_define(const string &definition)
+	void preprocessor::include_header(directive_context &context, bool next)
 	{
-	    for(unsigned int i=0; i<m_global_defines.size(); i++)
+	    token_span tokens = context.tokens;
+
+	    if(tokens.size() < 3)
 	    {
-	        if(definition == m_global_defines[i].name)
+	        return;
+	    }
+
+	    string_view include_enclosure = tokens[2].token;
+	    string include_file = "";
+	    file_scope header_scope = local;
+
+	    if(include_enclosure == "<")
+	    {
+	        for(unsigned int i=3; i<tokens.size(); i++)
 	        {
-	            m_global_defines.erase(m_global_defines.begin() + i, (m_global_defines.begin() + i) + 1);
-	            return true;
+	            if(tokens[i].token == ">")
+	            {
+	                break;
+	            }
+	            else
+	            {
+	                include_file += tokens[i].token;
+	            }
 	        }
+
+	        m_headers_scope[atom_table::intern(include_file)] = global;
+	        header_scope = global;
 	    }
+	    else if(include_enclosure[0] == '"')
+	    {
+	        for(unsigned int i=1; i<tokens[2].token.size(); i++)
+	        {
+	            if(tokens[2].token.at(i) == '"')
+	            {
+	                break;
+	            }
+	            else
+	            {
+	                include_file += tokens[2].token.at(i);
+	            }
+	        }
 
-	    for(unsigned int i=0; i<m_local_defines.size(); i++)
+	        m_headers_scope[atom_table::intern(include_file)] = local;
+	        header_scope = local;
+	    }
+	    else
 	    {
-	        if(definition == m_local_defines[i].name)
+	        return;
+	    }
+
+	    if(m_include_depth >= max_include_depth)
+	    {
+	        add_error(context, "#include nested too deeply", tokens[0].location);
+
+	        return;
+	    }
+
+	    //Headers can be included many times, the guarded ones are skipped by preprocess
+	    unsigned int search_directory = no_directory;
+	    atom path = next ? m_resolver.resolve_next(include_file, header_scope, context.search_directory, search_directory)
+	        : m_resolver.resolve(include_file, header_scope, context.directory, &search_directory);
+
+	    if(path != no_atom)
+	    {
+	        preprocess(include_file, path, context.output, search_directory); //To output the processed headers code
+	    }
+
+	    atom include_atom = atom_table::intern(include_file);
+
+	    if(!is_header_parsed(include_atom))
+	    {
+	        m_headers.push_back(include_file);
+	        m_parsed_headers.insert(include_atom);
+	    }
+	}
+
+	void preprocessor::handle_if(directive_context &context)
+	{
+	    //The condition of a group inside of a skipped one is not evaluated
+	    open_condition(context, is_active() && parse_expression(context));
+	}
+
+	void preprocessor::handle_ifdef(directive_context &context)
+	{
+	    const preprocessor_token *name = is_active() ? macro_name(context) : 0;
+
+	    open_condition(context, name && is_defined(name->id));
+	}
+
+	void preprocessor::handle_ifndef(directive_context &context)
+	{
+	    const preprocessor_token *name = is_active() ? macro_name(context) : 0;
+
+	    open_condition(context, name && !is_defined(name->id));
+	}
+
+	void preprocessor::handle_elif(directive_context &context)
+	{
+	    if(next_branch(context))
+	    {
+	        m_conditions.back().state = parse_expression(context) ? condition_taking : condition_skipping;
+	    }
+	}
+
+	void preprocessor::handle_elifdef(directive_context &context)
+	{
+	    if(next_branch(context))
+	    {
+	        const preprocessor_token *name = macro_name(context);
+
+	        m_conditions.back().state = name && is_defined(name->id) ? condition_taking : condition_skipping;
+	    }
+	}
+
+	void preprocessor::handle_elifndef(directive_context &context)
+	{
+	    if(next_branch(context))
+	    {
+	        const preprocessor_token *name = macro_name(context);
+
+	        m_conditions.back().state = name && !is_defined(name->id) ? condition_taking : condition_skipping;
+	    }
+	}
+
+	void preprocessor::handle_else(directive_context &context)
+	{
+	    if(next_branch(context))
+	    {
+	        m_conditions.back().state = condition_taking;
+	    }
+	}
+
+	void preprocessor::handle_endif(directive_context &context)
+	{
+	    if(m_conditions.size() <= context.conditions_base)
+	    {
+	        add_error(context, "#endif without #if", context.tokens[0].location);
+
+	        return;
+	    }
+
+	    m_conditions.pop_back();
+	}
+
+	void preprocessor::handle_error(directive_context &context)
+	{
+        string error_message;
+
+        //Copy error message
+        for(unsigned int i=2; i<context.tokens.size(); i++)
+        {
+            error_message += context.tokens[i].token;
+            error_message += " ";
+        }
+
+        add_error(context, error_message, context.tokens[0].location);
+	}
+
+	void preprocessor::handle_pragma(directive_context &context)
+	{
+	    const preprocessor_token *name = directive_operand(context.tokens);
+
+	    //#pragma once is for the preprocessor only
+	    if(name && name->token == "once")
+	    {
+	        context.once = true;
+
+	        return;
+	    }
+
+	    //Other pragmas are kept for the compiler like gcc -E does (pack, diagnostic, etc)
+	    token_span tokens = context.tokens;
+	    size_t last = tokens.size() - 1;
+
+	    while(last > 0 && tokens[last].type == new_line)
+	    {
+	        last--;
+	    }
+
+	    const char *begin = tokens[0].token.data();
+	    const char *end = tokens[last].token.data() + tokens[last].token.size();
+
+	    resolved_location hash;
+
+	    context.output.fill(' ', source_manager::resolve(tokens[0].location, hash) ? hash.column - 1 : 0);
+	    context.output.write(begin, end - begin);
+	    context.output.put('\n');
+	}
+
+	void preprocessor::handle_line(directive_context &context)
+	{
+	    //The operands can be macros, they are expanded first
+	    const vector<expanded_token> &expanded = m_expander.expand(strip_macro_definition(context.tokens));
+	    const preprocessor_token *operands[2] = { 0, 0 };
+	    unsigned int count = 0;
+
+	    for(unsigned int i=0; i<expanded.size(); i++)
+	    {
+	        const preprocessor_token &token = expanded[i].token;
+
+	        if(is_blank(token))
 	        {
-	            m_local_defines.erase(m_local_defines.begin() + i, (m_local_defines.begin() + i) + 1);
-	            return true;
+	            continue;
 	        }
+
+	        if(count < 2)
+	        {
+	            operands[count] = &token;
+	        }
+
+	        count++;
 	    }
 
-	    return false;
+	    integer_literal line;
+
+	    if(count < 1 || count > 2 || !preprocessor_tokenizer::get_literal(*operands[0], line) || operands[0]->type != number
+	        || (count == 2 && (operands[1]->type != strings || operands[1]->token.front() != '"')))
+	    {
+	        add_error(context, "Invalid #line directive", context.tokens[0].location);
+
+	        return;
+	    }
+
+	    //The number is the one of the line that follows the directive
+	    context.line_delta = int(line.value) - int(source_manager::get_line(context.tokens.back().location) + 1);
+
+	    if(count == 2)
+	    {
+	        context.presumed_file = string(operands[1]->token.substr(1, operands[1]->token.size() - 2));
+	    }
 	}
 
-	const string preprocessor::file_path(const string &file, file_scope scope)
+	const string preprocessor::parse_file(const string &file, file_scope scope)
+	{
+	    atom path = m_resolver.resolve(file, scope);
+
+	    string_sink output;
+
+	    if(path != no_atom)
+	    {
+	        preprocess(file, path, output);
+	    }
+
+	    return move(output.str());
+	}
+
+	void preprocessor::parse_file(const string &file, output_sink &output, file_scope scope)
 	{
-	    string file_path = "";
-        if(scope == local)
+	    atom path = m_resolver.resolve(file, scope);
+
+	    if(path != no_atom)
+	    {
+	        preprocess(file, path, output);
+	    }
+	}
+
+	void preprocessor::preprocess(const string &file, atom path, output_sink &output, unsigned int search_directory)
+	{
+	    string full_file_path(atom_table::get_spelling(path));
+
+        //Guarded files are not opened again, whatever the path used to reach them
+        atom file_atom = path;
+        unordered_map<atom, file_stamp>::const_iterator known_stamp = m_file_stamps.find(file_atom);
+        file_stamp stamp;
+
+        if(known_stamp != m_file_stamps.end())
         {
-            for(unsigned int i=0; i<m_local_includes.size(); i++)
-            {
-                string temp_file_path = m_local_includes[i];
-                if(temp_file_path.at(temp_file_path.size() -1) != '/')
-                    temp_file_path += "/";
+            stamp = known_stamp->second;
+        }
+        else if(get_file_stamp(full_file_path, stamp))
+        {
+            m_file_stamps[file_atom] = stamp;
+        }
+        else
+        {
+            return;
+        }
 
-                temp_file_path += file;
+        if(is_guarded(stamp.identity))
+        {
+            return;
+        }
 
-                if(file_exists(temp_file_path))
-                {
-                    file_path = temp_file_path;
-                    break;
-                }
+        //The file is tokenized up to each conditional directive, the groups that are not taken
+        //are skipped over its bytes without tokenizing them. The content and the tokens come
+        //from the cache, that can be shared with other preprocessors. The files too big to be
+        //kept whole are read in batches instead, tokenizing the skipped groups too.
+        bool streamed = m_stream_size > 0 && stamp.size > m_stream_size;
+        token_stream stream(min<size_t>(m_stream_size, 1024 * 1024));
+        tokenized_file batch;
+        shared_ptr<cached_file> source_file;
+        shared_ptr<const token_chunk> chunk;
+
+        if(streamed)
+        {
+            if(!stream.open(full_file_path))
+            {
+                return;
             }
+
+            stream.next(batch);
         }
         else
         {
-            for(unsigned int i=0; i<m_global_includes.size(); i++)
+            source_file = m_files->get_file(full_file_path, stamp);
+
+            if(!source_file)
+            {
+                return;
+            }
+
+            chunk = m_files->get_chunk(source_file, 0);
+        }
+
+        //Headers included with "" are searched first next to this file
+        size_t directory_end = full_file_path.rfind('/');
+        atom directory = atom_table::intern(directory_end != string::npos ? string_view(full_file_path).substr(0, directory_end + 1) : string_view("./"));
+
+        //The conditional stack is shared with the included files, this one only sees the groups it opens
+        directive_context context = { token_span(), file, file_atom, directory, search_directory, 0, m_conditions.size(), output, string(), 0, false };
+
+        //The whole file is an include guard if the first line that is not blank is an #ifndef
+        //and only blank lines follow the #endif that closes it
+        atom guard = no_atom;
+        bool guard_closed = false;
+        bool guard_possible = true;
+
+        m_include_depth++;
+
+        while(true)
+        {
+            const tokenized_file &lines = streamed ? batch : chunk->lines;
+            const source_buffer &source = *lines.get_source();
+            source_location base = lines.get_base();
+
+            for(size_t position=0; position<lines.size(); position++)
             {
-                string temp_file_path = m_global_includes[i];
-                if(temp_file_path.at(temp_file_path.size() -1) != '/')
-                    temp_file_path += "/";
+                token_span tokens = lines[position];
+
+                //Parse directive
+                if(tokens[0].type == operator_symbol && tokens[0].id == punctuator_hash)
+                {
+                    //The lines of a directive continued with \\ are contiguous so they are joined on a single span
+                    while(position + 1 < lines.size() && is_continued(tokens))
+                    {
+                        position++;
+                        tokens = token_span(tokens.begin(), lines[position].end());
+                    }
+
+                    directive_type directive = tokens.size() > 1 && tokens[1].type == identifier ? preprocessor_tokenizer::get_directive_type(tokens[1].id) : no_directive;
+                    const directive_entry &entry = m_directives[directive];
+
+                    if(guard_possible)
+                    {
+                        if(guard == no_atom)
+                        {
+                            guard = guard_macro(tokens, directive);
+                            guard_possible = guard != no_atom;
+                        }
+                        else if(guard_closed || (m_conditions.size() == context.conditions_base + 1
+                            && (directive == directive_elif || directive == directive_elifdef || directive == directive_elifndef || directive == directive_else)))
+                        {
+                            guard_possible = false;
+                        }
+                    }
+
+                    //On skipped groups only the conditionals are handled, to follow their nesting
+                    if(entry.handler && (entry.conditional || is_active()))
+                    {
+                        context.tokens = tokens;
+                        context.offset = (streamed ? stream.get_position() : 0) + (tokens[0].token.data() - source.data());
+
+                        (this->*entry.handler)(context);
+                    }
 
-                temp_file_path += file;
+                    if(guard_possible && m_conditions.size() == context.conditions_base)
+                    {
+                        guard_closed = true;
+                    }
+                }
 
-                if(file_exists(temp_file_path))
+                //Parse code
+                else
+                {
+                    if(guard_possible && (guard == no_atom || guard_closed) && !is_blank_line(tokens))
+                    {
+                        guard_possible = false;
+                    }
+
+                    //Lines without macros are copied from the source as they are, most lines are like that
+                    if(is_active() && !has_macros(tokens))
+                    {
+                        write_source_line(tokens, source, output);
+                    }
+                    else if(is_active())
+                    {
+                        //Function like macro invocations can continue on the next lines, position is moved to the last one read
+                        size_t line = position;
+                        const vector<expanded_token> &expanded = m_expander.expand_line(lines, line);
+
+                        position = line;
+
+                        source_location end = line_start(tokens, source, base); //End of the last source token written
+                        bool expansion = false; //The previous token was produced by a macro
+
+                        for(unsigned int i=0; i<expanded.size(); i++)
+                        {
+                            const preprocessor_token &token = expanded[i].token;
+
+                            if(!expansion && end != no_location && token.location >= end)
+                            {
+                                //Source tokens and the first token of an expansion keep their distance to the previous
+                                //source token, a space separates the lines of an invocation that continues on the next ones
+                                size_t gap = token.location - end;
+
+                                output.fill(' ', memchr(source.data() + (end - base), '\n', gap) ? 1 : gap);
+                            }
+                            else if(expanded[i].leading_space)
+                            {
+                                output.put(' ');
+                            }
+
+                            output.write(token.token);
+
+                            expansion = !expanded[i].from_source;
+
+                            if(expanded[i].from_source)
+                            {
+                                end = token.location + token.token.size();
+                            }
+                        }
+
+                        output.put('\n');
+                    }
+                }
+            }
+
+            if(streamed)
+            {
+                if(!stream.next(batch))
                 {
-                    file_path = temp_file_path;
                     break;
                 }
+
+                continue;
             }
+
+            //All the lines read, the last one is a conditional directive and the group that follows is skipped if not taken
+            size_t source_position = chunk->end_position;
+
+            if(source_position < source.size() && !is_active())
+            {
+                preprocessor_tokenizer::skip_group(source.data(), source.size(), source_position);
+            }
+
+            if(source_position >= source.size())
+            {
+                break;
+            }
+
+            chunk = m_files->get_chunk(source_file, source_position);
         }
 
-        return file_path;
+        //Groups left open at the end of the file are closed
+        if(m_conditions.size() > context.conditions_base)
+        {
+            add_error(context, "Unterminated conditional directive", m_conditions[context.conditions_base].location);
+            m_conditions.resize(context.conditions_base);
+
+            guard_closed = false;
+        }
+
+        if((guard_possible && guard_closed) || context.once)
+        {
+            header_guard file_guard = { guard_possible && guard_closed ? guard : no_atom, context.once };
+
+            m_guards[stamp.identity] = file_guard;
+        }
+
+        m_include_depth--;
+	}
+
+	const string preprocessor::file_path(const string &file, file_scope scope)
+	{
+	    atom path = m_resolver.resolve(file, scope);
+
+	    if(path == no_atom)
+	    {
+	        return string();
+	    }
+
+	    return string(atom_table::get_spelling(path));
 	}
 }
@@ -1,473 +1,1495 @@
-#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <cstring>
 #include <iostream>
-#include "misc.hpp"
+#include "source_buffer.hpp"
+#include "atom_table.hpp"
+#include "character_scanner.hpp"
+#include "source_manager.hpp"
 #include "preprocessor_tokenizer.hpp"
 
 using namespace std;
 
 namespace cpp_parser
 {
-    vector< vector<preprocessor_token> > preprocessor_tokenizer::tokenize_file(const string &file_name)
-	{
-	    //Open file
-	    ifstream file_stream(file_name.c_str());
+    namespace
+    {
+        /**
+         * Layout of the id of literal tokens whose value was decoded by the tokenizer,
+         * the value is stored shifted on the remaining bits
+         */
+        const unsigned int literal_packed = 1;             /*< The id holds a value */
+        const unsigned int literal_packed_unsigned = 2;    /*< The value is unsigned */
+        const unsigned int literal_value_shift = 2;
 
-	    //To store the content of the file
-	    string file_content = "";
+        const size_t not_a_directive = ~size_t(0);
 
-        //store each byte of the opened file on the file_content variable
-	    while(!file_stream.eof())
-	    {
-	        char byte;
-	        file_stream.read(&byte, sizeof(char));
-	        file_content += byte;
-	    }
+        const unsigned int min_data_run = 8;    /*< Numbers a list needs to be tokenized as a data run */
 
-        //Tokenize the string and return the vector with tokens
-	    return tokenize_string(file_content);
-	}
+        /**
+         * Location of a byte of a content that starts at the given base
+         */
+        inline source_location location_of(source_location base, size_t position)
+        {
+            return base == no_location ? no_location : base + position;
+        }
 
-	vector< vector<preprocessor_token> > preprocessor_tokenizer::tokenize_string(const string &characters)
-	{
-		char byte, byte_peek;
-		std::string token = "";
-		std::vector<preprocessor_token> tokens;
-		std::vector< vector<preprocessor_token> > lines;
-
-		bool inside_string = false;
-		char string_enclosure;
-		bool single_line_comment = false;
-		bool multiple_line_comment = false;
-		bool multiple_symbols_operator = false;
-		bool is_identifier = false;
-		bool is_number = false;
-		bool multiline_preprocessor = false;
-		bool line_ended = false;
-
-        unsigned int line = 1;
-		unsigned int column = 1;
-
-		for(unsigned int byte_position=0; byte_position<characters.size(); byte_position++)
-		{
-			byte = characters[byte_position];
-
-			if((byte_position + 1) < characters.size())
-			{
-			    byte_peek = characters[byte_position + 1];
-			}
-			else
-			{
-			    byte_peek = '\n';
-			}
-
-            if(is_number)
+        /**
+         * Classes of bytes that decide how the tokenizer handles a token starting with them
+         */
+        enum character_class
+        {
+            class_other,        /*< Single byte tokens like \ @ ` and non ascii bytes */
+            class_space,        /*< Spaces, tabs and other blanks except new lines */
+            class_new_line,     /*< \n */
+            class_digit,        /*< 0-9 */
+            class_letter,       /*< a-z A-Z _ $ */
+            class_quote,        /*< " or ' */
+            class_slash,        /*< / that may start a comment */
+            class_punctuator    /*< { } [ ] ( ) ; , + - * % ^ ~ = < > & | ! . : ? # */
+        };
+
+        /**
+         * Flags of the bytes that can continue a token
+         */
+        enum character_flag
+        {
+            flag_identifier = 1,    /*< a-z A-Z 0-9 _ $ */
+            flag_number = 2         /*< a-z A-Z 0-9 . */
+        };
+
+        /**
+         * Class and flags for every possible byte value
+         */
+        struct character_table
+        {
+            unsigned char classes[256];
+            unsigned char flags[256];
+        };
+
+        constexpr character_table make_character_table()
+        {
+            character_table table = {};
+
+            for(int byte = 0; byte < 256; byte++)
             {
-                token += byte;
+                bool digit = byte >= '0' && byte <= '9';
+                bool alpha = (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z');
+                bool punctuator = false;
 
-                if(!isalnum(byte_peek) && byte_peek != '.')
+                switch(byte)
                 {
-                    is_number = false;
+                    case '{': case '}': case '[': case ']': case '(': case ')':
+                    case ';': case ',': case '+': case '-': case '*': case '%':
+                    case '^': case '~': case '=': case '<': case '>': case '&':
+                    case '|': case '!': case '.': case ':': case '?': case '#':
+                        punctuator = true;
+                }
+
+                if(byte == '\n')
+                    table.classes[byte] = class_new_line;
+                else if(byte == ' ' || byte == '\t' || byte == '\v' || byte == '\f' || byte == '\r')
+                    table.classes[byte] = class_space;
+                else if(digit)
+                    table.classes[byte] = class_digit;
+                else if(alpha || byte == '_' || byte == '$')
+                    table.classes[byte] = class_letter;
+                else if(byte == '"' || byte == '\'')
+                    table.classes[byte] = class_quote;
+                else if(byte == '/')
+                    table.classes[byte] = class_slash;
+                else if(punctuator)
+                    table.classes[byte] = class_punctuator;
+                else
+                    table.classes[byte] = class_other;
 
-                    add_token(token, line, column, number, tokens);
+                if(digit || alpha || byte == '_' || byte == '$')
+                    table.flags[byte] |= flag_identifier;
 
-                    token = "";
-                }
+                if(digit || alpha || byte == '.')
+                    table.flags[byte] |= flag_number;
             }
-            else if(is_identifier)
+
+            return table;
+        }
+
+        constexpr character_table character_classes = make_character_table();
+
+        /**
+         * Spelling of a punctuator, its kind and the coarse token type it gets
+         */
+        struct punctuator_entry
+        {
+            const char *spelling;
+            punctuator_type kind;
+            token_type type;
+        };
+
+        constexpr punctuator_entry punctuator_spellings[] =
+        {
+            { "{", punctuator_left_brace, body_begin }, { "}", punctuator_right_brace, body_end },
+            { "[", punctuator_left_bracket, array_begin }, { "]", punctuator_right_bracket, array_end },
+            { "(", punctuator_left_parenthesis, parenthesis_begin }, { ")", punctuator_right_parenthesis, parethesis_end },
+            { ";", punctuator_semicolon, other }, { ":", punctuator_colon, operator_symbol },
+            { "...", punctuator_ellipsis, operator_symbol }, { "?", punctuator_question, operator_symbol },
+            { "::", punctuator_scope, scope_resolution }, { ".", punctuator_dot, member_access_object },
+            { ".*", punctuator_dot_star, operator_symbol }, { "->", punctuator_arrow, member_access_pointer },
+            { "->*", punctuator_arrow_star, operator_symbol }, { "~", punctuator_tilde, operator_symbol },
+            { "!", punctuator_exclaim, operator_symbol }, { "+", punctuator_plus, operator_symbol },
+            { "-", punctuator_minus, operator_symbol }, { "*", punctuator_star, operator_symbol },
+            { "/", punctuator_slash, operator_symbol }, { "%", punctuator_percent, operator_symbol },
+            { "^", punctuator_caret, operator_symbol }, { "&", punctuator_ampersand, operator_symbol },
+            { "|", punctuator_pipe, operator_symbol }, { "=", punctuator_equal, operator_symbol },
+            { "+=", punctuator_plus_equal, operator_symbol }, { "-=", punctuator_minus_equal, operator_symbol },
+            { "*=", punctuator_star_equal, operator_symbol }, { "/=", punctuator_slash_equal, operator_symbol },
+            { "%=", punctuator_percent_equal, operator_symbol }, { "^=", punctuator_caret_equal, operator_symbol },
+            { "&=", punctuator_ampersand_equal, operator_symbol }, { "|=", punctuator_pipe_equal, operator_symbol },
+            { "==", punctuator_equal_equal, operator_symbol }, { "!=", punctuator_exclaim_equal, operator_symbol },
+            { "<", punctuator_less, operator_symbol }, { ">", punctuator_greater, operator_symbol },
+            { "<=", punctuator_less_equal, operator_symbol }, { ">=", punctuator_greater_equal, operator_symbol },
+            { "<=>", punctuator_spaceship, operator_symbol }, { "&&", punctuator_ampersand_ampersand, operator_symbol },
+            { "||", punctuator_pipe_pipe, operator_symbol }, { "<<", punctuator_less_less, operator_symbol },
+            { ">>", punctuator_greater_greater, operator_symbol }, { "<<=", punctuator_less_less_equal, operator_symbol },
+            { ">>=", punctuator_greater_greater_equal, operator_symbol }, { "++", punctuator_plus_plus, operator_symbol },
+            { "--", punctuator_minus_minus, operator_symbol }, { ",", punctuator_comma, other },
+            { "#", punctuator_hash, operator_symbol }, { "##", punctuator_hash_hash, operator_symbol },
+        };
+
+        /**
+         * Trie of the punctuator spellings walked by the tokenizer to find the
+         * longest punctuator (maximal munch) on a single pass. Bytes are mapped
+         * to a small alphabet so the nodes stay compact.
+         */
+        struct punctuator_trie
+        {
+            unsigned char letters[256];         /*< Index of the byte on the alphabet plus one, 0 if not used by any spelling */
+            unsigned char children[96][32];     /*< Next node for each letter, 0 if there is none */
+            unsigned char entries[96];          /*< Index of the punctuator_entry ending on the node plus one, 0 if none */
+        };
+
+        template<size_t Count>
+        constexpr punctuator_trie make_punctuator_trie(const punctuator_entry (&entries)[Count])
+        {
+            punctuator_trie trie = {};
+            unsigned int letter_count = 0;
+            unsigned int node_count = 1; //Node 0 is the root
+
+            for(size_t i = 0; i < Count; i++)
             {
-                token += byte;
+                unsigned int node = 0;
 
-                if((isspace(byte_peek) || !isalnum(byte_peek)) && (byte_peek != '_' && byte_peek != '$'))
+                for(const char *spelling = entries[i].spelling; *spelling; spelling++)
                 {
-                    is_identifier = false;
+                    unsigned char byte = *spelling;
+
+                    if(!trie.letters[byte])
+                    {
+                        if(++letter_count >= 32)
+                            throw "Too many punctuator letters";
+
+                        trie.letters[byte] = letter_count;
+                    }
 
-                    add_token(token, line, column, identifier, tokens);
+                    if(!trie.children[node][trie.letters[byte]])
+                    {
+                        if(node_count >= 96)
+                            throw "Too many punctuator trie nodes";
 
-                    token = "";
+                        trie.children[node][trie.letters[byte]] = node_count++;
+                    }
+
+                    node = trie.children[node][trie.letters[byte]];
                 }
+
+                trie.entries[node] = i + 1;
             }
-            else if(multiple_symbols_operator)
+
+            return trie;
+        }
+
+        constexpr punctuator_trie punctuators = make_punctuator_trie(punctuator_spellings);
+
+        /**
+         * Finds the longest punctuator starting at a position
+         * @param bytes The characters being tokenized
+         * @param position Where the punctuator starts
+         * @param size Amount of characters
+         * @param end Set to the position after the punctuator
+         * @return The matching entry or null if no punctuator starts there
+         */
+        inline const punctuator_entry* match_punctuator(const unsigned char *bytes, size_t position, size_t size, size_t &end)
+        {
+            const punctuator_entry *match = 0;
+            unsigned int node = 0;
+
+            for(size_t i = position; i < size; i++)
             {
-                token += byte;
+                unsigned int letter = punctuators.letters[bytes[i]];
 
-                if(!is_operator(byte_peek))
+                if(!letter || !(node = punctuators.children[node][letter]))
                 {
-                    multiple_symbols_operator = false;
-
-                    add_token(token, line, column, operator_symbol, tokens);
+                    break;
+                }
 
-                    token = "";
+                if(punctuators.entries[node])
+                {
+                    match = &punctuator_spellings[punctuators.entries[node] - 1];
+                    end = i + 1;
                 }
             }
-            else if(multiple_line_comment)
+
+            return match;
+        }
+
+        /**
+         * Spelling of a keyword or directive and the value it maps to
+         */
+        struct name_entry
+        {
+            const char *name;
+            unsigned int type;
+        };
+
+        constexpr name_entry keyword_names[] =
+        {
+            { "alignas", keyword_alignas }, { "alignof", keyword_alignof }, { "and", keyword_and },
+            { "and_eq", keyword_and_eq }, { "asm", keyword_asm }, { "auto", keyword_auto },
+            { "bitand", keyword_bitand }, { "bitor", keyword_bitor }, { "bool", keyword_bool },
+            { "break", keyword_break }, { "case", keyword_case }, { "catch", keyword_catch },
+            { "char", keyword_char }, { "char16_t", keyword_char16_t }, { "char32_t", keyword_char32_t },
+            { "char8_t", keyword_char8_t }, { "class", keyword_class }, { "co_await", keyword_co_await },
+            { "co_return", keyword_co_return }, { "co_yield", keyword_co_yield }, { "compl", keyword_compl },
+            { "concept", keyword_concept }, { "const", keyword_const }, { "const_cast", keyword_const_cast },
+            { "consteval", keyword_consteval }, { "constexpr", keyword_constexpr }, { "constinit", keyword_constinit },
+            { "continue", keyword_continue }, { "decltype", keyword_decltype }, { "default", keyword_default },
+            { "delete", keyword_delete }, { "do", keyword_do }, { "double", keyword_double },
+            { "dynamic_cast", keyword_dynamic_cast }, { "else", keyword_else }, { "enum", keyword_enum },
+            { "explicit", keyword_explicit }, { "export", keyword_export }, { "extern", keyword_extern },
+            { "false", keyword_false }, { "float", keyword_float }, { "for", keyword_for },
+            { "friend", keyword_friend }, { "goto", keyword_goto }, { "if", keyword_if },
+            { "inline", keyword_inline }, { "int", keyword_int }, { "long", keyword_long },
+            { "mutable", keyword_mutable }, { "namespace", keyword_namespace }, { "new", keyword_new },
+            { "noexcept", keyword_noexcept }, { "not", keyword_not }, { "not_eq", keyword_not_eq },
+            { "nullptr", keyword_nullptr }, { "operator", keyword_operator }, { "or", keyword_or },
+            { "or_eq", keyword_or_eq }, { "private", keyword_private }, { "protected", keyword_protected },
+            { "public", keyword_public }, { "register", keyword_register }, { "reinterpret_cast", keyword_reinterpret_cast },
+            { "requires", keyword_requires }, { "return", keyword_return }, { "short", keyword_short },
+            { "signed", keyword_signed }, { "sizeof", keyword_sizeof }, { "static", keyword_static },
+            { "static_assert", keyword_static_assert }, { "static_cast", keyword_static_cast }, { "struct", keyword_struct },
+            { "switch", keyword_switch }, { "template", keyword_template }, { "this", keyword_this },
+            { "thread_local", keyword_thread_local }, { "throw", keyword_throw }, { "true", keyword_true },
+            { "try", keyword_try }, { "typedef", keyword_typedef }, { "typeid", keyword_typeid },
+            { "typename", keyword_typename }, { "union", keyword_union }, { "unsigned", keyword_unsigned },
+            { "using", keyword_using }, { "virtual", keyword_virtual }, { "void", keyword_void },
+            { "volatile", keyword_volatile }, { "wchar_t", keyword_wchar_t }, { "while", keyword_while },
+            { "xor", keyword_xor }, { "xor_eq", keyword_xor_eq },
+        };
+
+        constexpr name_entry directive_names[] =
+        {
+            { "define", directive_define }, { "undef", directive_undef }, { "include", directive_include },
+            { "include_next", directive_include_next }, { "import", directive_import }, { "if", directive_if },
+            { "ifdef", directive_ifdef }, { "ifndef", directive_ifndef }, { "elif", directive_elif },
+            { "elifdef", directive_elifdef }, { "elifndef", directive_elifndef }, { "else", directive_else },
+            { "endif", directive_endif }, { "error", directive_error }, { "warning", directive_warning },
+            { "pragma", directive_pragma }, { "line", directive_line }, { "ident", directive_ident },
+        };
+
+        constexpr size_t name_length(const char *name)
+        {
+            size_t length = 0;
+
+            while(name[length])
+            {
+                length++;
+            }
+
+            return length;
+        }
+
+        /**
+         * FNV-1a hash of a name, the seed is searched at compile time to get a perfect hash
+         */
+        constexpr unsigned int hash_name(const char *name, size_t size, unsigned int seed)
+        {
+            unsigned int hash = 2166136261u ^ seed;
+
+            for(size_t i = 0; i < size; i++)
+            {
+                hash ^= static_cast<unsigned char>(name[i]);
+                hash *= 16777619u;
+            }
+
+            return hash;
+        }
+
+        /**
+         * Hash table without collisions for a fixed set of names
+         */
+        template<size_t Slots>
+        struct perfect_hash
+        {
+            unsigned int seed;
+            size_t shortest;            /*< Length of the shortest name */
+            size_t longest;             /*< Length of the longest name */
+            bool first_bytes[256];      /*< Bytes that start some name, to reject most identifiers without hashing */
+            unsigned char slots[Slots]; /*< Index of the entry plus one, 0 for empty slots */
+        };
+
+        /**
+         * Tries seeds until one places every name on a different slot,
+         * fails to compile if none is found.
+         */
+        template<size_t Slots, size_t Count>
+        constexpr perfect_hash<Slots> make_perfect_hash(const name_entry (&entries)[Count])
+        {
+            static_assert(Count < 255, "Too many names for the slot type");
+
+            for(unsigned int seed = 0; seed < 100000; seed++)
             {
-                token += byte;
+                perfect_hash<Slots> table = {};
+                bool collision = false;
+
+                table.seed = seed;
 
-                if(byte == '*' && byte_peek == '/') //End of multiline comment
+                for(size_t i = 0; i < Count && !collision; i++)
                 {
-                    multiple_line_comment = false;
+                    unsigned int slot = hash_name(entries[i].name, name_length(entries[i].name), seed) % Slots;
 
-                    token += byte_peek;
-                    byte_position++;
+                    if(table.slots[slot])
+                    {
+                        collision = true;
+                    }
+                    else
+                    {
+                        table.slots[slot] = i + 1;
+                    }
+                }
 
-                    column++; //Since readed next character we need to increment column
+                if(!collision)
+                {
+                    table.shortest = name_length(entries[0].name);
 
-                    add_token(token, line - count_character('\n', token), //Since multiple lines save the first line where started
-                              column-2, multi_comment, tokens);
+                    for(size_t i = 0; i < Count; i++)
+                    {
+                        size_t length = name_length(entries[i].name);
 
-			        token = "";
+                        table.shortest = length < table.shortest ? length : table.shortest;
+                        table.longest = length > table.longest ? length : table.longest;
+                        table.first_bytes[static_cast<unsigned char>(entries[i].name[0])] = true;
+                    }
+
+                    return table;
                 }
+            }
 
-                if(byte == '\n')
+            throw "No perfect hash seed found";
+        }
+
+        constexpr perfect_hash<1024> keyword_hash = make_perfect_hash<1024>(keyword_names);
+        constexpr perfect_hash<64> directive_hash = make_perfect_hash<64>(directive_names);
+
+        /**
+         * Looks up a name on a perfect hash table
+         * @return The type of the matching entry or 0 if not found
+         */
+        template<size_t Slots, size_t Count>
+        unsigned int find_name(string_view name, const perfect_hash<Slots> &table, const name_entry (&entries)[Count])
+        {
+            if(name.size() < table.shortest || name.size() > table.longest || !table.first_bytes[static_cast<unsigned char>(name[0])])
+            {
+                return 0;
+            }
+
+            unsigned int slot = table.slots[hash_name(name.data(), name.size(), table.seed) % Slots];
+
+            if(slot == 0)
+            {
+                return 0;
+            }
+
+            const name_entry &entry = entries[slot - 1];
+
+            if(name.compare(entry.name) != 0)
+            {
+                return 0;
+            }
+
+            return entry.type;
+        }
+
+        /**
+         * Builds the table used to know the directive_type of an atom
+         */
+        vector<unsigned char> make_directive_atoms()
+        {
+            vector<unsigned char> directives;
+
+            for(const name_entry &entry : directive_names)
+            {
+                atom name = atom_table::intern(entry.name);
+
+                if(name >= directives.size())
                 {
-                    line++;
-                    column = 1;
-                    line_ended = true;
+                    directives.resize(name + 1, no_directive);
                 }
+
+                directives[name] = entry.type;
             }
-            else if(single_line_comment)
+
+            return directives;
+        }
+
+        /**
+         * Checks if a line that was just finished completes a conditional directive,
+         * the lines that follow it may have to be skipped
+         * @param tokens All the tokens
+         * @param line_start Index of the first token of the finished line
+         * @param directive_start Index of the # of a directive continued on the next lines, ~0 for none
+         */
+        bool completes_conditional(const vector<preprocessor_token> &tokens, size_t line_start, size_t &directive_start)
+        {
+            if(directive_start == not_a_directive)
             {
-                if(byte == '\n') //End of single line comment
+                if(line_start >= tokens.size() || tokens[line_start].token != "#")
                 {
-                    single_line_comment = false;
+                    return false;
+                }
 
-                    add_token(token, line, column, comment, tokens);
+                directive_start = line_start;
+            }
 
-                    line++;
-                    column = 1;
+            //Lines ending with \ continue the directive, the new line token may follow it
+            size_t last = tokens.size();
 
-			        token = "";
+            if(last > line_start && tokens[last - 1].type == new_line)
+            {
+                last--;
+            }
+
+            if(last > line_start && tokens[last - 1].token == "\\")
+            {
+                return false;
+            }
+
+            size_t name = directive_start + 1;
+
+            directive_start = not_a_directive;
+
+            if(name >= tokens.size() || tokens[name].type != identifier)
+            {
+                return false;
+            }
+
+            switch(preprocessor_tokenizer::get_directive_type(tokens[name].id))
+            {
+                case directive_if:
+                case directive_ifdef:
+                case directive_ifndef:
+                case directive_elif:
+                case directive_elifdef:
+                case directive_elifndef:
+                case directive_else:
+                    return true;
+
+                default:
+                    return false;
+            }
+        }
 
-			        lines.push_back(tokens);
-                    tokens.clear();
-                    line_ended = true;
+        /**
+         * Lines read since a batch started, to know where it can end
+         */
+        struct batch_state
+        {
+            int depth;          /*< Parentheses open on code lines */
+            bool directive;     /*< The last line is a directive that continues with \ */
+        };
+
+        /**
+         * Checks if a batch of lines can end after a line that was just finished, a function like
+         * macro invocation can't be open: no parenthesis is open and the line doesn't end with an
+         * identifier (its ( could be on the next line). The lines of a continued directive are kept
+         * together and the parentheses of directives are not counted, they are not code.
+         * @param tokens All the tokens
+         * @param line_start Index of the first token of the finished line
+         * @param state The state after the previous line, updated with this one
+         */
+        bool ends_batch(const vector<preprocessor_token> &tokens, size_t line_start, batch_state &state)
+        {
+            size_t last = tokens.size();
+
+            while(last > line_start && tokens[last - 1].type == new_line)
+            {
+                last--;
+            }
+
+            bool directive = state.directive || (last > line_start && tokens[line_start].type == operator_symbol && tokens[line_start].id == punctuator_hash);
+            bool continued = last > line_start && tokens[last - 1].token == "\\";
+
+            state.directive = directive && continued;
+
+            if(directive)
+            {
+                return !continued && state.depth == 0;
+            }
+
+            for(size_t i = line_start; i < last; i++)
+            {
+                if(tokens[i].type == parenthesis_begin)
+                {
+                    state.depth++;
                 }
-                else
+                else if(tokens[i].type == parethesis_end && state.depth > 0)
                 {
-                    token += byte;
+                    state.depth--;
                 }
             }
-            else if(inside_string)
+
+            while(last > line_start && (tokens[last - 1].type == comment || tokens[last - 1].type == multi_comment))
+            {
+                last--;
+            }
+
+            return state.depth == 0 && (last == line_start || tokens[last - 1].type != identifier);
+        }
+
+        /**
+         * Finds the end of a number, they can contain letters and dots (suffixes, exponents, hex digits),
+         * digit separators like 1'000 and the sign of exponents like 1e+5 or 0x1p-3
+         * @param position Position of the first character of the number
+         * @return Position after the last character of the number
+         */
+        size_t find_number_end(const unsigned char *bytes, size_t position, size_t size)
+        {
+            while(position + 1 < size)
             {
-                token += byte;
+                unsigned char next = bytes[position + 1];
 
-                if(byte == '\\') //Read escaped characters in case of \" \' to no detect end of string wrongly
+                if(character_classes.flags[next] & flag_number)
                 {
-                    byte_position++;
-                    column++; //Since readed next character we need to increment column
-                    token += byte_peek;
+                    position++;
                 }
-                else if(byte == '"' && string_enclosure == '"') //End of string was found
+                else if(next == '\'' && position + 2 < size && (character_classes.flags[bytes[position + 2]] & flag_identifier))
                 {
-                    inside_string = false;
+                    position += 2;
                 }
-                else if(byte == '\'' && string_enclosure == '\'')
+                else if((next == '+' || next == '-') && ((bytes[position] | 0x20) == 'e' || (bytes[position] | 0x20) == 'p'))
                 {
-                    inside_string = false;
+                    position++;
                 }
-
-                if(!inside_string) //Finally save the full string token
+                else
                 {
-                    add_token(token, line, column, strings, tokens);
-			        token = "";
+                    break;
                 }
             }
-			else if(!isspace(byte) && byte != '\n')
-			{
-			    if(byte == '/' && byte_peek == '*') //Check if comes multiple line commment
-			    {
-			        token += byte;
-			        multiple_line_comment = true;
-			    }
-			    else if(byte == '/' && byte_peek == '/') //Check if comes single line comment
-			    {
-			        token += byte;
-			        single_line_comment = true;
-			    }
-			    else if(byte == '"' || byte == '\'') //Check if entering string or character
-			    {
-			        token += byte;
-			        inside_string = true;
-			        string_enclosure = byte;
-			    }
-			    else if(isdigit(byte))
-			    {
-			        token += byte;
-
-			        //Check if number is longer than 1 character
-					if(isalnum(byte_peek) || byte_peek == '.')
-					{
-					    //to be able to parse numbers as part of identifier
-                        is_number = true;
-					}
-					else
-					{
-					    add_token(token, line, column, number, tokens);
-				        token = "";
-					}
-			    }
-				else if(isalpha(byte) || byte == '_' || byte == '$') //Other normal keywords and identifiers
-				{
-					token += byte;
-
-					//Check if identifer is more that 1 letter long
-					if((!isspace(byte_peek) && isalnum(byte_peek)) || (byte_peek == '_' || byte_peek == '$'))
-					{
-					    //to be able to parse numbers as part of identifier
-                        is_identifier = true;
-					}
-					else
-					{
-					    add_token(token, line, column, identifier, tokens);
-				        token = "";
-					}
-				}
-				else
-				{
-				    if(token != "") //Saves any identifier as token if available
-				    {
-				        add_token(token, line, column, get_identifier_type(token), tokens);
-				    }
-
-                    //Saves any other character like operators (should be only operators)
-                    token = byte;
-                    if(is_operator(byte) && is_operator(byte_peek)) //Check if multiple symbols operator
-					{
-					    multiple_symbols_operator = true;
-					}
-					else
-					{
-					    add_token(token, line, column, get_operator_type(byte), tokens);
-                        token = "";
-					}
-				}
-			}
-			else if(isspace(byte) && byte != '\n') //Action after a space is found
-			{
-			    if(token != " " && token != "") //Save last token
-			    {
-			        add_token(token, line, column, get_identifier_type(token), tokens);
-			        token = "";
-			    }
-			}
-			else if(byte == '\n') //End of line
-			{
-                if(tokens.size() > 0) //Check if multiple lines macro definition
+
+            return position + 1;
+        }
+
+        /**
+         * Finds the end of a list of numbers separated by commas on a single line, like the tables
+         * generated by xxd -i. It ends before anything else, an identifier for example.
+         * @param position Position after the first number of the list
+         * @return Position after the last number or comma of the list, the given position if the list is shorter than min_data_run
+         */
+        size_t find_data_run_end(const unsigned char *bytes, size_t position, size_t size)
+        {
+            size_t end = position;
+            unsigned int numbers = 1;
+
+            while(true)
+            {
+                //The blanks between the numbers are short, they are skipped without the scanners
+                size_t next = end;
+
+                while(next < size && character_classes.classes[bytes[next]] == class_space)
                 {
-                    if(tokens.at(0).token == "#" && tokens.at(tokens.size()-1).token == "\\")
-                    {
-                        //TODO: Reparar el problema de los defines con multiples lineas esto que hice no sirve con los nuevos cambios
-                        //We are on a multiple lines macro definition so we continue parsing until the macro ends
-                        token = "";
-                    }
-                    else
-                    {
-                        if(token != " ") //Just finish reading the line
-                        {
-                            add_token(token, line, column, new_line, tokens);
-                        }
-                    }
+                    next++;
+                }
+
+                if(next >= size || bytes[next] != ',')
+                {
+                    break;
                 }
-			    else //Encountered an empty line
-			    {
-			        if(token != " ")
-                    {
-                        add_token(token, line, column, new_line, tokens);
-                    }
-			    }
 
-			    line++;
-			    column = 1;
+                end = ++next;
+
+                while(next < size && character_classes.classes[bytes[next]] == class_space)
+                {
+                    next++;
+                }
 
-			    lines.push_back(tokens);
-                tokens.clear();
-                line_ended = true;
-			}
+                bool digit = next < size && (character_classes.classes[bytes[next]] == class_digit
+                    || (bytes[next] == '.' && next + 1 < size && character_classes.classes[bytes[next + 1]] == class_digit));
 
-            if(!line_ended)
+                if(!digit)
+                {
+                    break;
+                }
+
+                end = find_number_end(bytes, next, size);
+                numbers++;
+            }
+
+            return numbers >= min_data_run ? end : position;
+        }
+
+        /**
+         * Checks if the current line is part of a directive, it starts with # or continues a line ending with \
+         * @param tokens All the tokens
+         * @param line_start Index of the first token of the current line
+         */
+        bool in_directive(const vector<preprocessor_token> &tokens, size_t line_start)
+        {
+            //The new line token may follow the backslash
+            size_t previous = line_start;
+
+            if(previous > 0 && tokens[previous - 1].type == new_line)
             {
-                column++;
+                previous--;
             }
-            else
+
+            if(previous > 0 && tokens[previous - 1].token == "\\")
             {
-                line_ended = false;
+                return true;
             }
+
+            return line_start < tokens.size() && tokens[line_start].type == operator_symbol && tokens[line_start].id == punctuator_hash;
+        }
+
+        /**
+         * Checks if a data run can start on the current line. The commas of directives can be counted
+         * by macros (the replacement of a macro that counts its arguments for example) and the ones
+         * inside of parentheses can separate the arguments of a function like macro invocation.
+         * @param tokens All the tokens
+         * @param line_start Index of the first token of the current line
+         * @param depth Parentheses open on the code lines before the current position
+         */
+        bool allows_data_run(const vector<preprocessor_token> &tokens, size_t line_start, int depth)
+        {
+            return depth == 0 && !in_directive(tokens, line_start);
+        }
+
+        /**
+         * Finds the end of a literal that ends at the end of its line if not closed
+         * @param position Position after the opening quote
+         * @return Position of the closing quote or of the new line, size if none of them was found
+         */
+        size_t find_literal_end(const char *characters, size_t size, size_t position, char enclosure)
+        {
+            while(position < size && characters[position] != enclosure && characters[position] != '\n')
+            {
+                if(characters[position] == '\\' && position + 1 < size)
+                {
+                    //An escaped new line continues the literal on the next line
+                    if(characters[position + 1] == '\r' && position + 2 < size && characters[position + 2] == '\n')
+                    {
+                        position++;
+                    }
+
+                    position++;
+                }
+
+                position++;
+            }
+
+            return position < size ? position : size;
+        }
+
+        /**
+         * Skips a string or character literal of an inactive line, they end at the end of the line if not closed
+         * @return Position after the closing quote or of the new line
+         */
+        size_t skip_inactive_literal(const char *characters, size_t size, size_t position)
+        {
+            char enclosure = characters[position];
+
+            position = find_literal_end(characters, size, position + 1, enclosure);
+
+            return position < size && characters[position] == enclosure ? position + 1 : position;
+        }
+    }
+
+    tokenized_file preprocessor_tokenizer::tokenize_file(const string &file_name)
+	{
+	    //Map the file or read it with a single call when it can't be mapped
+	    shared_ptr<source_buffer> file_content(new source_buffer());
+
+	    if(!file_content->open(file_name))
+	    {
+	        return tokenized_file();
+	    }
+
+	    tokenized_file file(file_content, source_manager::add_file(file_content, atom_table::intern(file_name)));
+
+        //Tokenize the buffer in place, the tokens keep pointing to it
+	    size_t position = 0;
+
+	    tokenize(file_content->data(), file_content->size(), position, stop_condition(), file);
+
+	    return file;
+	}
+
+	tokenized_file preprocessor_tokenizer::tokenize_string(const string &characters)
+	{
+	    shared_ptr<source_buffer> content(new source_buffer());
+	    content->assign(characters);
+
+	    tokenized_file file(content);
+	    size_t position = 0;
+
+	    tokenize(content->data(), content->size(), position, stop_condition(), file);
+
+	    return file;
+	}
+
+	tokenized_file preprocessor_tokenizer::tokenize_string(const char *characters, size_t size)
+	{
+	    tokenized_file file;
+	    size_t position = 0;
+
+	    tokenize(characters, size, position, stop_condition(), file);
+
+	    return file;
+	}
+
+	void preprocessor_tokenizer::tokenize_string(const char *characters, size_t size, tokenized_file &file)
+	{
+	    size_t position = 0;
+
+	    tokenize(characters, size, position, stop_condition(), file);
+	}
+
+	void preprocessor_tokenizer::tokenize_lines(const char *characters, size_t size, size_t &position, tokenized_file &file)
+	{
+	    stop_condition stop = { true, 0, false };
+
+	    tokenize(characters, size, position, stop, file);
+	}
+
+	void preprocessor_tokenizer::tokenize_batch(const char *characters, size_t size, size_t &position, size_t batch_size, bool end_of_source, tokenized_file &file)
+	{
+	    stop_condition stop = { false, batch_size > 0 ? batch_size : 1, !end_of_source };
+
+	    tokenize(characters, size, position, stop, file);
+	}
+
+	void preprocessor_tokenizer::tokenize(const char *characters, size_t size, size_t &position, const stop_condition &stop, tokenized_file &file)
+	{
+		std::vector<preprocessor_token> &tokens = file.get_tokens();
+		source_location base = file.get_base(); //The location of each token is its position from the base
+		size_t line_start = tokens.size(); //Index of the first token of the current line
+		size_t directive_start = not_a_directive; //Index of the # of a directive that continues on the next lines
+		size_t batch_start = position;
+		size_t split_position = position; //Where the batch can end, the lines after it are left for the next call if partial
+		size_t split_lines = file.size();
+		batch_state batch = { 0, false };
+		int depth = 0; //Parentheses open on code lines, data runs can't be macro arguments
+
+		//Rough estimation to allocate the storage only once for most files
+		if(position == 0)
+		{
+		    file.reserve(size / 6 + 16, size / 32 + 16);
+		}
+
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(characters);
+
+		while(position < size)
+		{
+		    size_t token_begin = position;
+		    unsigned char byte_class = character_classes.classes[bytes[position]];
+
+		    //A dot followed by a digit starts a number like .5 instead of a punctuator
+		    if(bytes[position] == '.' && position + 1 < size && character_classes.classes[bytes[position + 1]] == class_digit)
+		    {
+		        byte_class = class_digit;
+		    }
+		    //Encoding prefixes are part of the character or string literal: L'a' u8"a"
+		    else if(bytes[position] == 'L' || bytes[position] == 'U' || bytes[position] == 'u')
+		    {
+		        size_t quote = position + (bytes[position] == 'u' && position + 1 < size && bytes[position + 1] == '8' ? 2 : 1);
+
+		        if(quote < size && (bytes[quote] == '\'' || bytes[quote] == '"'))
+		        {
+		            byte_class = class_quote;
+		            position = quote;
+		        }
+		    }
+
+		    switch(byte_class)
+		    {
+		        case class_space:
+		        {
+		            position = character_scanner::skip_blanks(characters, position + 1, size);
+
+		            break;
+		        }
+
+		        case class_new_line:
+		        {
+		            //Lines of a multiple lines macro definition don't get a new_line token
+		            //TODO: Reparar el problema de los defines con multiples lineas esto que hice no sirve con los nuevos cambios
+		            if(!(tokens.size() > line_start && tokens[line_start].token == "#" && tokens.back().token == "\\"))
+		            {
+		                add_token(string_view(), location_of(base, position), new_line, tokens);
+		            }
+
+		            position++;
+
+		            file.end_line();
+
+		            if(stop.conditionals && completes_conditional(tokens, line_start, directive_start))
+		            {
+		                return;
+		            }
+
+		            if(stop.batch_size && ends_batch(tokens, line_start, batch))
+		            {
+		                if(position - batch_start >= stop.batch_size)
+		                {
+		                    return;
+		                }
+
+		                split_position = position;
+		                split_lines = file.size();
+		            }
+
+		            line_start = tokens.size();
+
+		            break;
+		        }
+
+		        case class_digit:
+		        {
+		            position = find_number_end(bytes, position, size);
+
+		            //Long lists of numbers are a single token that is copied as it is, they are not decoded one by one
+		            if(allows_data_run(tokens, line_start, depth))
+		            {
+		                size_t run_end = find_data_run_end(bytes, position, size);
+
+		                if(run_end != position)
+		                {
+		                    add_token(string_view(&characters[token_begin], run_end - token_begin), location_of(base, token_begin), data_run, tokens);
+
+		                    position = run_end;
+
+		                    break;
+		                }
+		            }
+
+		            string_view literal(&characters[token_begin], position - token_begin);
+		            integer_literal value;
+		            bool decoded = decode_integer(literal, value);
+
+		            add_token(literal, location_of(base, token_begin), number, tokens, pack_literal(decoded, value));
+
+		            break;
+		        }
+
+		        case class_letter:
+		        {
+		            position = character_scanner::skip_identifier(characters, position + 1, size);
+
+		            string_view name(&characters[token_begin], position - token_begin);
+
+		            add_token(name, location_of(base, token_begin), identifier, tokens, atom_table::intern(name));
+
+		            break;
+		        }
+
+		        case class_quote:
+		        {
+		            char string_enclosure = characters[position];
+
+		            position++;
+
+		            //Skip escaped characters in case of \" \' to no detect end of string wrongly, a literal
+		            //not closed ends with its line as on skipped groups unless the new line is escaped
+		            while(true)
+		            {
+		                position = character_scanner::find_string_special(characters, position, size, string_enclosure);
+
+		                if(position >= size || characters[position] != '\\')
+		                {
+		                    break;
+		                }
+
+		                if(position + 2 < size && characters[position + 1] == '\r' && characters[position + 2] == '\n')
+		                {
+		                    position++;
+		                }
+
+		                position += 2;
+		            }
+
+		            position = min(position, size);
+
+		            bool closed = position < size && characters[position] == string_enclosure;
+		            string_view literal(&characters[token_begin], position - token_begin + closed);
+		            unsigned int id = 0;
+
+		            if(string_enclosure == '\'')
+		            {
+		                integer_literal value;
+		                bool decoded = decode_character(literal, value);
+
+		                id = pack_literal(decoded, value);
+		            }
+
+		            add_token(literal, location_of(base, token_begin), strings, tokens, id);
+
+		            position += closed;
+
+		            break;
+		        }
+
+		        case class_slash:
+		        {
+		            if(position + 1 < size && characters[position + 1] == '*') //Multiple line comment
+		            {
+		                //The end is searched from the * that opened the comment so /*/ is a full comment
+		                position = character_scanner::find_comment_end(characters, position + 1, size);
+
+		                if(position >= size) //Unterminated comments are discarded
+		                {
+		                    break;
+		                }
+
+		                position++;
+
+		                add_token(string_view(&characters[token_begin], position - token_begin + 1), location_of(base, token_begin), multi_comment, tokens);
+
+		                position++;
+
+		                break;
+		            }
+		            else if(position + 1 < size && characters[position + 1] == '/') //Single line comment
+		            {
+		                //The comment ends at the end of the line, unless the line is continued
+		                while(true)
+		                {
+		                    const void *line_end = memchr(&characters[position], '\n', size - position);
+
+		                    position = line_end ? static_cast<const char*>(line_end) - characters : size;
+
+		                    size_t last = characters[position - 1] == '\r' ? position - 1 : position;
+
+		                    if(position >= size || characters[last - 1] != '\\')
+		                    {
+		                        break;
+		                    }
+
+		                    position++;
+		                }
+
+		                add_token(string_view(&characters[token_begin], position - token_begin), location_of(base, token_begin), comment, tokens);
+
+		                if(position < size)
+		                {
+		                    position++;
+
+		                    file.end_line();
+
+		                    if(stop.conditionals && completes_conditional(tokens, line_start, directive_start))
+		                    {
+		                        return;
+		                    }
+
+		                    if(stop.batch_size && ends_batch(tokens, line_start, batch))
+		                    {
+		                        if(position - batch_start >= stop.batch_size)
+		                        {
+		                            return;
+		                        }
+
+		                        split_position = position;
+		                        split_lines = file.size();
+		                    }
+
+		                    line_start = tokens.size();
+		                }
+
+		                break;
+		            }
+
+		            //Not a comment so it is handled as any other punctuator
+		        }
+		        // fall through
+
+		        case class_punctuator:
+		        {
+		            //Take the longest punctuator so <<= is a single token and +- two of them
+		            size_t end = position + 1;
+		            const punctuator_entry *entry = match_punctuator(bytes, position, size, end);
+
+		            add_token(string_view(&characters[token_begin], end - token_begin), location_of(base, token_begin), entry->type, tokens, entry->kind);
+
+		            //The parentheses of directives are not counted, they are not code
+		            if(entry->type == parenthesis_begin && !in_directive(tokens, line_start))
+		            {
+		                depth++;
+		            }
+		            else if(entry->type == parethesis_end && depth > 0 && !in_directive(tokens, line_start))
+		            {
+		                depth--;
+		            }
+
+		            position = end;
+
+		            break;
+		        }
+
+		        default:
+		        {
+		            add_token(string_view(&characters[token_begin], 1), location_of(base, token_begin), other, tokens);
+
+		            position++;
+
+		            break;
+		        }
+		    }
 		}
 
-		return lines;
+		//The lines after the last place where the batch can end are tokenized again with the characters that follow
+		if(stop.partial)
+		{
+		    file.resize(split_lines);
+		    position = split_position;
+
+		    return;
+		}
+
+		//Save the last line when the content doesn't ends with a new line
+		if(tokens.size() > line_start)
+		{
+		    file.end_line();
+		}
 	}
 
-	bool preprocessor_tokenizer::is_operator(const char& byte)
+	void preprocessor_tokenizer::skip_group(const char *characters, size_t size, size_t &position)
 	{
-	    switch(byte)
+	    unsigned int depth = 0; //Conditionals opened inside of the group
+
+	    while(position < size)
 	    {
-	        case '+':
-	        case '-':
-	        case '*':
-	        case '/':
-	        case '%':
-	        case '^':
-	        case '~':
-	        case '=':
-	        case '<':
-	        case '>':
-	        case '&':
-	        case '|':
-	        case '!':
-	        case '.':
-	        case ':':
-	        case '?':
-	        case '#':
+	        size_t line_begin = position;
+	        size_t current = character_scanner::skip_blanks(characters, position, size);
 
-                return true;
-	    }
+	        if(current < size && characters[current] == '#')
+	        {
+	            current = character_scanner::skip_blanks(characters, current + 1, size);
+
+	            size_t name_end = character_scanner::skip_identifier(characters, current, size);
+
+	            switch(get_directive_type(string_view(&characters[current], name_end - current)))
+	            {
+	                case directive_if:
+	                case directive_ifdef:
+	                case directive_ifndef:
+	                    depth++;
+	                    break;
+
+	                case directive_elif:
+	                case directive_elifdef:
+	                case directive_elifndef:
+	                case directive_else:
+	                    if(depth == 0)
+	                    {
+	                        position = line_begin;
+	                        return;
+	                    }
+	                    break;
+
+	                case directive_endif:
+	                    if(depth == 0)
+	                    {
+	                        position = line_begin;
+	                        return;
+	                    }
+
+	                    depth--;
+	                    break;
+
+	                default:
+	                    break;
+	            }
+
+	            current = name_end;
+	        }
+
+	        //Skip the rest of the line, it can continue on the next ones with a backslash or with a comment
+	        while(true)
+	        {
+	            current = character_scanner::find_line_special(characters, current, size);
+
+	            if(current >= size)
+	            {
+	                position = size;
+	                return;
+	            }
+
+	            char special = characters[current];
+
+	            if(special == '\n')
+	            {
+	                position = current + 1;
+	                break;
+	            }
+	            else if(special == '\\')
+	            {
+	                //A backslash and a new line join the lines, anything else is not special
+	                size_t next = current + 1 < size && characters[current + 1] == '\r' ? current + 2 : current + 1;
+
+	                if(next < size && characters[next] == '\n')
+	                {
+	                    current = next;
+	                }
 
-	    return false;
+	                current++;
+	            }
+	            else if(special == '/' && current + 1 < size && characters[current + 1] == '*')
+	            {
+	                current = character_scanner::find_comment_end(characters, current + 2, size) + 2;
+	            }
+	            else if(special == '/' && current + 1 < size && characters[current + 1] == '/')
+	            {
+	                //The comment ends at the end of the line, unless the line is continued
+	                while(true)
+	                {
+	                    const void *line_end = memchr(&characters[current], '\n', size - current);
+
+	                    current = line_end ? static_cast<const char*>(line_end) - characters : size;
+
+	                    size_t last = characters[current - 1] == '\r' ? current - 1 : current;
+
+	                    if(current >= size || characters[last - 1] != '\\')
+	                    {
+	                        break;
+	                    }
+
+	                    current++;
+	                }
+	            }
+	            else if(special == '\'' && current > line_begin && characters[current - 1] >= '0' && characters[current - 1] <= '9')
+	            {
+	                //Digit separator like 1'000
+	                current++;
+	            }
+	            else if(special == '"' || special == '\'')
+	            {
+	                current = skip_inactive_literal(characters, size, current);
+	            }
+	            else
+	            {
+	                current++;
+	            }
+	        }
+	    }
 	}
 
-	token_type preprocessor_tokenizer::get_operator_type(const char &byte)
+	token_type preprocessor_tokenizer::get_identifier_type(string_view token)
 	{
-	    if(is_operator(byte))
-            return operator_symbol;
-
-	    switch(byte)
+	    if(get_keyword_type(token) != no_keyword)
 	    {
-	        case '(':
-                return parenthesis_begin;
-            case ')':
-                return parethesis_end;
-            case '{':
-                return body_begin;
-            case '}':
-                return body_end;
-            case '[':
-                return array_begin;
-            case ']':
-                return array_end;
+	        return keyword;
 	    }
 
-	    return other;
+	    return identifier;
 	}
 
-	token_type preprocessor_tokenizer::get_identifier_type(const string &token)
+	keyword_type preprocessor_tokenizer::get_keyword_type(string_view token)
 	{
-	    static std::vector<std::string> cpp_keywords;
+	    return static_cast<keyword_type>(find_name(token, keyword_hash, keyword_names));
+	}
 
-	    if(cpp_keywords.size() <= 0)
-        {
-            cpp_keywords.push_back("and");
-            cpp_keywords.push_back("and_eq");
-            cpp_keywords.push_back("asm");
-            cpp_keywords.push_back("auto");
-            cpp_keywords.push_back("bitand");
-            cpp_keywords.push_back("bitor");
-            cpp_keywords.push_back("bool");
-            cpp_keywords.push_back("break");
-            cpp_keywords.push_back("case");
-            cpp_keywords.push_back("catch");
-            cpp_keywords.push_back("char");
-            cpp_keywords.push_back("class");
-            cpp_keywords.push_back("compl");
-            cpp_keywords.push_back("const");
-            cpp_keywords.push_back("const_cast");
-            cpp_keywords.push_back("continue");
-            cpp_keywords.push_back("default");
-            cpp_keywords.push_back("delete");
-            cpp_keywords.push_back("do");
-            cpp_keywords.push_back("double");
-            cpp_keywords.push_back("dynamic_cast");
-            cpp_keywords.push_back("else");
-            cpp_keywords.push_back("enum");
-            cpp_keywords.push_back("explicit");
-            cpp_keywords.push_back("export");
-            cpp_keywords.push_back("extern");
-            cpp_keywords.push_back("false");
-            cpp_keywords.push_back("float");
-            cpp_keywords.push_back("for");
-            cpp_keywords.push_back("friend");
-            cpp_keywords.push_back("goto");
-            cpp_keywords.push_back("if");
-            cpp_keywords.push_back("inline");
-            cpp_keywords.push_back("int");
-            cpp_keywords.push_back("long");
-            cpp_keywords.push_back("mutable");
-            cpp_keywords.push_back("namespace");
-            cpp_keywords.push_back("new");
-            cpp_keywords.push_back("not");
-            cpp_keywords.push_back("not_eq");
-            cpp_keywords.push_back("operator");
-            cpp_keywords.push_back("or");
-            cpp_keywords.push_back("or_eq");
-            cpp_keywords.push_back("private");
-            cpp_keywords.push_back("protected");
-            cpp_keywords.push_back("public");
-            cpp_keywords.push_back("register");
-            cpp_keywords.push_back("reintepret_cast");
-            cpp_keywords.push_back("return");
-            cpp_keywords.push_back("short");
-            cpp_keywords.push_back("signed");
-            cpp_keywords.push_back("sizeof");
-            cpp_keywords.push_back("static");
-            cpp_keywords.push_back("static_cast");
-            cpp_keywords.push_back("struct");
-            cpp_keywords.push_back("switch");
-            cpp_keywords.push_back("template");
-            cpp_keywords.push_back("this");
-            cpp_keywords.push_back("throw");
-            cpp_keywords.push_back("true");
-            cpp_keywords.push_back("try");
-            cpp_keywords.push_back("typedef");
-            cpp_keywords.push_back("typeid");
-            cpp_keywords.push_back("typename");
-            cpp_keywords.push_back("union");
-            cpp_keywords.push_back("unsigned");
-            cpp_keywords.push_back("using");
-            cpp_keywords.push_back("virtual");
-            cpp_keywords.push_back("void");
-            cpp_keywords.push_back("volatile");
-            cpp_keywords.push_back("wchar_t");
-            cpp_keywords.push_back("while");
-            cpp_keywords.push_back("xor");
-            cpp_keywords.push_back("xor_eq");
-        }
+	directive_type preprocessor_tokenizer::get_directive_type(string_view token)
+	{
+	    return static_cast<directive_type>(find_name(token, directive_hash, directive_names));
+	}
 
-	    for(unsigned int i=0; i<cpp_keywords.size(); i++)
+	directive_type preprocessor_tokenizer::get_directive_type(atom name)
+	{
+	    //Directive of every atom up to the biggest atom of a directive name, interned on the first call
+	    static const vector<unsigned char> directives = make_directive_atoms();
+
+	    return name < directives.size() ? static_cast<directive_type>(directives[name]) : no_directive;
+	}
+
+	string_view preprocessor_tokenizer::get_keyword_name(keyword_type keyword)
+	{
+	    for(const name_entry &entry : keyword_names)
 	    {
-	        if(cpp_keywords[i] == token)
+	        if(entry.type == static_cast<unsigned int>(keyword))
 	        {
-	            return keyword;
+	            return entry.name;
 	        }
 	    }
 
-	    return identifier;
+	    return string_view();
 	}
 
-	void preprocessor_tokenizer::add_token(const string &token, unsigned int line, unsigned int column, token_type type, std::vector<preprocessor_token> &tokens)
+	void preprocessor_tokenizer::add_token(string_view token, source_location location, token_type type, std::vector<preprocessor_token> &tokens, unsigned int id)
 	{
 	    preprocessor_token token_struct;
 
 	    token_struct.token = token;
-        token_struct.line = line;
+	    token_struct.location = location;
+	    token_struct.type = type;
+	    token_struct.id = id;
 
-        if(column == 1 && token.size() == 0) //For empty lines
-        {
-            token_struct.column = column;
-        }
-        else if(column > token.size()) //Normal operation
-        {
-            token_struct.column = column - token.size() + 1;
-        }
-        else if(column == token.size()) //For lines that start with some identifier or word
-        {
-            token_struct.column = 1;
-        }
-        else // everything else
-        {
-            token_struct.column = column;
-        }
+	    tokens.push_back(token_struct);
+	}
+
+	bool preprocessor_tokenizer::decode_integer(string_view literal, integer_literal &value)
+	{
+	    size_t position = 0;
+	    unsigned int base = 10;
+	    uintmax_t result = 0;
+	    bool overflow = false;
+
+	    if(literal.size() > 1 && literal[0] == '0')
+	    {
+	        if(literal[1] == 'x' || literal[1] == 'X')
+	        {
+	            base = 16;
+	            position = 2;
+	        }
+	        else if(literal[1] == 'b' || literal[1] == 'B')
+	        {
+	            base = 2;
+	            position = 2;
+	        }
+	        else
+	        {
+	            base = 8;
+	            position = 1;
+	        }
+	    }
+
+	    size_t digits = position;
+
+	    for(; position < literal.size(); position++)
+	    {
+	        unsigned char character = literal[position];
+	        unsigned int digit;
+
+	        if(character == '\'')
+	        {
+	            continue;
+	        }
+	        else if(character >= '0' && character <= '9')
+	        {
+	            digit = character - '0';
+	        }
+	        else if(base == 16 && isxdigit(character))
+	        {
+	            digit = (character | 0x20) - 'a' + 10;
+	        }
+	        else
+	        {
+	            break;
+	        }
+
+	        if(digit >= base)
+	        {
+	            return false;
+	        }
+
+	        overflow = overflow || result > (UINTMAX_MAX - digit) / base;
+	        result = result * base + digit;
+	    }
+
+	    if((position == digits && base != 8) || overflow)
+	    {
+	        return false;
+	    }
+
+	    //Valid suffixes are u combined with one of l, ll or z
+	    bool is_unsigned = false;
+	    bool has_size = false;
+
+	    for(; position < literal.size(); position++)
+	    {
+	        char character = literal[position];
+
+	        if((character == 'u' || character == 'U') && !is_unsigned)
+	        {
+	            is_unsigned = true;
+	        }
+	        else if((character == 'l' || character == 'L') && !has_size)
+	        {
+	            has_size = true;
+
+	            if(position + 1 < literal.size() && literal[position + 1] == character)
+	            {
+	                position++;
+	            }
+	        }
+	        else if((character == 'z' || character == 'Z') && !has_size)
+	        {
+	            has_size = true;
+	        }
+	        else
+	        {
+	            return false;
+	        }
+	    }
 
-        token_struct.type = type;
+	    //Without suffix a value that doesn't fit on the signed type becomes unsigned
+	    value.value = result;
+	    value.is_unsigned = is_unsigned || result > static_cast<uintmax_t>(INTMAX_MAX);
+
+	    return true;
+	}
+
+	bool preprocessor_tokenizer::decode_character(string_view literal, integer_literal &value)
+	{
+	    size_t position = literal.find('\'');
+	    size_t end = literal.size() - 1;
+
+	    if(position == string_view::npos || end <= position + 1 || literal[end] != '\'')
+	    {
+	        return false;
+	    }
+
+	    string_view prefix = literal.substr(0, position);
+	    unsigned long long result = 0;
+	    unsigned int characters = 0;
+
+	    for(position++; position < end; characters++)
+	    {
+	        unsigned long long character = static_cast<unsigned char>(literal[position++]);
+
+	        if(character == '\\')
+	        {
+	            if(position == end)
+	            {
+	                return false;
+	            }
+
+	            char escape = literal[position++];
+
+	            switch(escape)
+	            {
+	                case 'a': character = '\a'; break;
+	                case 'b': character = '\b'; break;
+	                case 'f': character = '\f'; break;
+	                case 'n': character = '\n'; break;
+	                case 'r': character = '\r'; break;
+	                case 't': character = '\t'; break;
+	                case 'v': character = '\v'; break;
+	                case '\\': case '\'': case '"': case '?': character = escape; break;
+
+	                case 'x':
+	                    character = 0;
+
+	                    if(position == end || !isxdigit(static_cast<unsigned char>(literal[position])))
+	                    {
+	                        return false;
+	                    }
+
+	                    for(; position < end && isxdigit(static_cast<unsigned char>(literal[position])); position++)
+	                    {
+	                        char digit = literal[position];
+
+	                        character = character * 16 + (digit <= '9' ? digit - '0' : (digit | 0x20) - 'a' + 10);
+	                    }
+	                    break;
+
+	                default:
+	                    if(escape < '0' || escape > '7')
+	                    {
+	                        return false;
+	                    }
+
+	                    character = escape - '0';
+
+	                    for(unsigned int digits = 1; digits < 3 && position < end && literal[position] >= '0' && literal[position] <= '7'; digits++)
+	                    {
+	                        character = character * 8 + (literal[position++] - '0');
+	                    }
+	                    break;
+	            }
+	        }
+
+	        //Multicharacter literals are ints with a byte for each character
+	        result = prefix.empty() ? (result << 8) | (character & 0xFF) : character;
+	    }
+
+	    //The value is converted to the type of the literal: char and wchar_t are
+	    //signed on this platform, char8_t, char16_t and char32_t unsigned
+	    if(prefix.empty())
+	    {
+	        value.value = characters == 1 ? static_cast<intmax_t>(static_cast<signed char>(result)) : static_cast<intmax_t>(static_cast<int>(result));
+	        value.is_unsigned = false;
+	    }
+	    else if(prefix == "L")
+	    {
+	        value.value = static_cast<intmax_t>(static_cast<int32_t>(result));
+	        value.is_unsigned = false;
+	    }
+	    else if(prefix == "u8")
+	    {
+	        value.value = static_cast<uint8_t>(result);
+	        value.is_unsigned = true;
+	    }
+	    else if(prefix == "u")
+	    {
+	        value.value = static_cast<uint16_t>(result);
+	        value.is_unsigned = true;
+	    }
+	    else if(prefix == "U")
+	    {
+	        value.value = static_cast<uint32_t>(result);
+	        value.is_unsigned = true;
+	    }
+	    else
+	    {
+	        return false;
+	    }
+
+	    return true;
+	}
+
+	bool preprocessor_tokenizer::get_literal(const preprocessor_token &token, integer_literal &value)
+	{
+	    bool is_character = token.type == strings && token.token.back() == '\'';
+
+	    if(token.type != number && !is_character)
+	    {
+	        return false;
+	    }
+
+	    if(token.id & literal_packed)
+	    {
+	        //Arithmetic shift to get back the sign
+	        value.value = static_cast<intmax_t>(static_cast<int>(token.id) >> literal_value_shift);
+	        value.is_unsigned = (token.id & literal_packed_unsigned) != 0;
+
+	        return true;
+	    }
+
+	    return is_character ? decode_character(token.token, value) : decode_integer(token.token, value);
+	}
+
+	unsigned int preprocessor_tokenizer::pack_literal(bool decoded, const integer_literal &value)
+	{
+	    if(!decoded)
+	    {
+	        return 0;
+	    }
+
+	    const intmax_t limit = intmax_t(1) << (31 - literal_value_shift);
+	    intmax_t signed_value = static_cast<intmax_t>(value.value);
+
+	    if((value.is_unsigned && value.value >= static_cast<uintmax_t>(limit)) || signed_value < -limit || signed_value >= limit)
+	    {
+	        return 0;
+	    }
 
-        tokens.push_back(token_struct);
+	    return (static_cast<unsigned int>(signed_value) << literal_value_shift) | literal_packed | (value.is_unsigned ? literal_packed_unsigned : 0);
 	}
 }
@@ -0,0 +1,169 @@
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source_buffer.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+	source_buffer::source_buffer()
+	:   m_data(0),
+	    m_size(0),
+	    m_mapped(false)
+	{
+	}
+
+	source_buffer::~source_buffer()
+	{
+	    release();
+	}
+
+	void source_buffer::release()
+	{
+	    if(m_mapped)
+	    {
+	        munmap(const_cast<char*>(m_data), m_size);
+	    }
+
+	    m_content.clear();
+	    m_data = 0;
+	    m_size = 0;
+	    m_mapped = false;
+	}
+
+	bool source_buffer::open(const string &file_name)
+	{
+	    if(file_name == "-")
+	    {
+	        return open(STDIN_FILENO);
+	    }
+
+	    int descriptor = ::open(file_name.c_str(), O_RDONLY);
+
+	    if(descriptor < 0)
+	    {
+	        release();
+	        return false;
+	    }
+
+	    bool opened = open(descriptor);
+
+	    close(descriptor);
+
+	    return opened;
+	}
+
+	bool source_buffer::open(int descriptor)
+	{
+	    release();
+
+	    struct stat file_status;
+
+	    if(fstat(descriptor, &file_status) != 0)
+	    {
+	        return false;
+	    }
+
+	    //Only regular files can be mapped, pipes and terminals are read as a stream
+	    if(S_ISREG(file_status.st_mode))
+	    {
+	        size_t file_size = file_status.st_size;
+
+	        if(file_size == 0)
+	        {
+	            return true;
+	        }
+
+	        void *region = mmap(0, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+	        if(region != MAP_FAILED)
+	        {
+	            madvise(region, file_size, MADV_SEQUENTIAL);
+
+	            m_data = static_cast<const char*>(region);
+	            m_size = file_size;
+	            m_mapped = true;
+
+	            return true;
+	        }
+
+	        return read_descriptor(descriptor, file_size);
+	    }
+
+	    return read_descriptor(descriptor, 0);
+	}
+
+	bool source_buffer::read_descriptor(int descriptor, size_t size_hint)
+	{
+	    //Read one byte more than the hint so a regular file is read with a single call
+	    size_t capacity = size_hint > 0 ? size_hint + 1 : 64 * 1024;
+	    size_t used = 0;
+
+	    m_content.resize(capacity);
+
+	    while(true)
+	    {
+	        if(used == capacity)
+	        {
+	            capacity *= 2;
+	            m_content.resize(capacity);
+	        }
+
+	        ssize_t bytes_read = read(descriptor, &m_content[used], capacity - used);
+
+	        if(bytes_read < 0)
+	        {
+	            if(errno == EINTR)
+	            {
+	                continue;
+	            }
+
+	            m_content.clear();
+	            return false;
+	        }
+	        else if(bytes_read == 0)
+	        {
+	            break;
+	        }
+
+	        used += bytes_read;
+	    }
+
+	    m_content.resize(used);
+
+	    m_data = m_content.data();
+	    m_size = m_content.size();
+
+	    return true;
+	}
+
+	void source_buffer::assign(const string &content)
+	{
+	    release();
+
+	    m_content = content;
+
+	    m_data = m_content.data();
+	    m_size = m_content.size();
+	}
+
+	char* source_buffer::resize(size_t size)
+	{
+	    if(m_mapped)
+	    {
+	        string content(m_data, m_size);
+
+	        assign(content);
+	    }
+
+	    m_content.resize(size);
+
+	    m_data = m_content.data();
+	    m_size = m_content.size();
+
+	    return &m_content[0];
+	}
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <mutex>
+#include "character_scanner.hpp"
+#include "source_manager.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+	source_manager& source_manager::instance()
+	{
+	    static source_manager manager;
+
+	    return manager;
+	}
+
+	source_location source_manager::add(const shared_ptr<const source_buffer> &source, atom name, unsigned long long first_line)
+	{
+	    size_t size = source ? source->size() : 0;
+
+	    //The files that don't fit get no locations, their tokens can't be resolved
+	    if(size > ~0u || size >= ~source_location(0) - m_next)
+	    {
+	        return no_location;
+	    }
+
+	    source_file file;
+	    file.base = m_next;
+	    file.size = size;
+	    file.name = name;
+	    file.first_line = first_line;
+	    file.source = source;
+	    file.lines_found = false;
+
+	    m_files.emplace_hint(m_files.end(), m_next, move(file));
+	    m_next += size + 1;
+
+	    return m_next - size - 1;
+	}
+
+	source_manager::source_file* source_manager::find(source_location location)
+	{
+	    //The file is the last one that starts at or before the location, each one has a location for its end
+	    map<source_location, source_file>::iterator found = m_files.upper_bound(location);
+
+	    if(found == m_files.begin())
+	    {
+	        return 0;
+	    }
+
+	    found--;
+
+	    return location - found->second.base <= found->second.size ? &found->second : 0;
+	}
+
+	source_location source_manager::add_file(const shared_ptr<const source_buffer> &source, atom name, unsigned long long first_line)
+	{
+	    source_manager &manager = instance();
+	    unique_lock<shared_mutex> lock(manager.m_mutex);
+
+	    return manager.add(source, name, first_line);
+	}
+
+	source_location source_manager::add_file(const shared_ptr<const source_buffer> &source, atom name, const file_stamp &stamp)
+	{
+	    source_manager &manager = instance();
+	    unique_lock<shared_mutex> lock(manager.m_mutex);
+
+	    unordered_map<file_identity, stamped_file, file_identity_hash>::iterator found = manager.m_stamped.find(stamp.identity);
+
+	    if(found != manager.m_stamped.end() && found->second.base != no_location
+	        && found->second.stamp.modified == stamp.modified && found->second.stamp.size == stamp.size)
+	    {
+	        source_file *file = manager.find(found->second.base);
+
+	        //The content is the same, it is taken to find the lines if the one added before was freed
+	        if(file && file->size == (source ? source->size() : 0))
+	        {
+	            if(file->source.expired())
+	            {
+	                file->source = source;
+	            }
+
+	            return file->base;
+	        }
+	    }
+
+	    stamped_file added = { stamp, manager.add(source, name, 1) };
+
+	    manager.m_stamped[stamp.identity] = added;
+
+	    return added.base;
+	}
+
+	void source_manager::remove_file(source_location base)
+	{
+	    source_manager &manager = instance();
+	    unique_lock<shared_mutex> lock(manager.m_mutex);
+
+	    manager.m_files.erase(base);
+	}
+
+	bool source_manager::resolve(source_location location, resolved_location &resolved)
+	{
+	    if(location == no_location)
+	    {
+	        return false;
+	    }
+
+	    source_manager &manager = instance();
+	    shared_lock<shared_mutex> shared(manager.m_mutex, defer_lock);
+	    unique_lock<shared_mutex> exclusive(manager.m_mutex, defer_lock);
+
+	    shared.lock();
+
+	    source_file *file = manager.find(location);
+
+	    if(!file)
+	    {
+	        return false;
+	    }
+
+	    //The lines are found the first time, the file can be removed meanwhile so it is searched again
+	    if(!file->lines_found)
+	    {
+	        shared.unlock();
+	        exclusive.lock();
+
+	        file = manager.find(location);
+
+	        if(!file)
+	        {
+	            return false;
+	        }
+
+	        if(!file->lines_found)
+	        {
+	            shared_ptr<const source_buffer> source = file->source.lock();
+
+	            if(!source)
+	            {
+	                return false;
+	            }
+
+	            file->line_starts.push_back(0);
+	            character_scanner::find_line_starts(source->data(), source->size(), file->line_starts);
+	            file->line_starts.shrink_to_fit();
+	            file->lines_found = true;
+	        }
+	    }
+
+	    unsigned int offset = location - file->base;
+	    vector<unsigned int>::const_iterator line = upper_bound(file->line_starts.begin(), file->line_starts.end(), offset) - 1;
+
+	    resolved.file = file->name;
+	    resolved.line = file->first_line + (line - file->line_starts.begin());
+	    resolved.column = offset - *line + 1;
+
+	    return true;
+	}
+
+	unsigned int source_manager::get_line(source_location location)
+	{
+	    resolved_location resolved;
+
+	    return resolve(location, resolved) ? resolved.line : 0;
+	}
+
+	size_t source_manager::size()
+	{
+	    source_manager &manager = instance();
+	    shared_lock<shared_mutex> lock(manager.m_mutex);
+
+	    return manager.m_next;
+	}
+}
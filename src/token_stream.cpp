@@ -0,0 +1,192 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "character_scanner.hpp"
+#include "preprocessor_tokenizer.hpp"
+#include "source_manager.hpp"
+#include "token_stream.hpp"
+
+using namespace std;
+
+namespace cpp_parser
+{
+    namespace
+    {
+        /**
+         * Base of the batches while they are tokenized, they are added to the source_manager once
+         * their size is known and their tokens are moved to the location they get
+         */
+        const source_location unregistered_base = 1;
+    }
+
+	token_stream::token_stream(size_t batch_size)
+	:   m_descriptor(-1),
+	    m_owned(false),
+	    m_end(true),
+	    m_failed(false),
+	    m_name(no_atom),
+	    m_batch_size(batch_size > 0 ? batch_size : 1),
+	    m_tail_position(0),
+	    m_base(no_location),
+	    m_position(0),
+	    m_line(1)
+	{
+	}
+
+	bool token_stream::open(const string &file_name)
+	{
+	    if(file_name == "-")
+	    {
+	        open(STDIN_FILENO, file_name);
+
+	        return true;
+	    }
+
+	    close();
+
+	    int descriptor = ::open(file_name.c_str(), O_RDONLY);
+
+	    if(descriptor < 0)
+	    {
+	        return false;
+	    }
+
+	    open(descriptor, file_name);
+
+	    m_owned = true;
+
+	    return true;
+	}
+
+	void token_stream::open(int descriptor, const string &name)
+	{
+	    close();
+
+	    m_descriptor = descriptor;
+	    m_end = false;
+	    m_name = atom_table::intern(name);
+	}
+
+	void token_stream::release()
+	{
+	    if(m_base != no_location)
+	    {
+	        source_manager::remove_file(m_base);
+	        m_base = no_location;
+	    }
+	}
+
+	void token_stream::close()
+	{
+	    release();
+
+	    if(m_owned)
+	    {
+	        ::close(m_descriptor);
+	    }
+
+	    m_descriptor = -1;
+	    m_owned = false;
+	    m_end = true;
+	    m_failed = false;
+	    m_tail.reset();
+	    m_tail_position = 0;
+	    m_position = 0;
+	    m_line = 1;
+	}
+
+	bool token_stream::next(tokenized_file &lines)
+	{
+	    size_t carried = m_tail ? m_tail->size() - m_tail_position : 0;
+
+	    lines.clear();
+	    release();
+
+	    if(m_end && carried == 0)
+	    {
+	        return false;
+	    }
+
+	    //The new batch starts where the last one ended
+	    if(m_tail)
+	    {
+	        m_position += m_tail_position;
+	        m_line += character_scanner::count_new_lines(m_tail->data(), m_tail_position);
+	    }
+
+	    //Each batch gets its own buffer so the lines handed out before stay valid
+	    shared_ptr<source_buffer> buffer(new source_buffer());
+	    size_t capacity = carried + m_batch_size;
+	    size_t used = carried;
+	    char *bytes = buffer->resize(capacity);
+
+	    if(carried > 0)
+	    {
+	        memcpy(bytes, m_tail->data() + m_tail_position, carried);
+	    }
+
+	    m_tail.reset();
+
+	    while(true)
+	    {
+	        //Reads of pipes and terminals can return less than asked
+	        while(!m_end && used < capacity)
+	        {
+	            ssize_t bytes_read = read(m_descriptor, bytes + used, capacity - used);
+
+	            if(bytes_read < 0 && errno == EINTR)
+	            {
+	                continue;
+	            }
+
+	            if(bytes_read <= 0)
+	            {
+	                m_failed = bytes_read < 0;
+	                m_end = true;
+	            }
+	            else
+	            {
+	                used += bytes_read;
+	            }
+	        }
+
+	        //Only complete lines are tokenized until the end of the source
+	        size_t size = used;
+
+	        if(!m_end)
+	        {
+	            const void *last_line = memrchr(bytes, '\n', used);
+
+	            size = last_line ? static_cast<const char*>(last_line) - bytes + 1 : 0;
+	        }
+
+	        bytes = buffer->resize(used);
+
+	        lines = tokenized_file(buffer, unregistered_base);
+
+	        size_t position = 0;
+
+	        preprocessor_tokenizer::tokenize_batch(bytes, size, position, m_batch_size, m_end, lines);
+
+	        if(position > 0 || m_end)
+	        {
+	            m_tail = buffer;
+	            m_tail_position = position;
+
+	            //Added once, with the size of the batch that is handed out
+	            if(position > 0)
+	            {
+	                m_base = source_manager::add_file(buffer, m_name, m_line);
+	                lines.rebase(m_base);
+	            }
+
+	            return position > 0;
+	        }
+
+	        //The lines read can't be split from the ones that follow, the buffer grows to read more of them
+	        capacity *= 2;
+	        bytes = buffer->resize(capacity);
+	    }
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef CONDITION_HPP
+#define CONDITION_HPP
+
+#define A 3
+#define B A
+#define C (2)
+#define S S
+#define ZERO 0
+#if A == 3 && B * 2 == 6
+int ok1;
+#endif
+#if ZERO && (1 / ZERO)
+int bad1;
+#else
+int ok2;
+#endif
+#if 1 || 1 / 0
+int ok3;
+#endif
+#if C + 1 == 3
+int ok4;
+#endif
+#if defined A && !defined(Q) && S == 0 && UNDEF == 0
+int ok5;
+#endif
+#if ZERO ? 1 / ZERO : 7 == 7
+int ok6;
+#endif
+#if -1
+int ok7;
+#endif
+#if 0x10 == 16 && 010 == 8 && 0b11 == 3 && 10ul == 10
+int ok8;
+#endif
+#if (2, 0)
+int bad9;
+#endif
+#if 1 << 62 > 0 && -5 / 2 == -2 && -5 % 2 == -1
+int ok10;
+#endif
+#define MINUS_ONE -1
+#if -1 > 0u && MINUS_ONE / 2u > 0 && 0xFFFFFFFFFFFFFFFF == -1 && (1 ? -1 : 0u) > 0
+int ok11;
+#endif
+#if '\377' < 0 && L'\0' - 1 < 0 && u'\0' - 1 > 0 && 'ab' == 0x6162
+int ok12;
+#endif
+#if 1'000'000 == 1000000 && 10uz == 10 && -1 >> 70 == -1
+int ok13;
+#endif
+
+#endif
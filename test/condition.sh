@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Conditions test case, only the lines of true conditions must be on the output
+../bin/Debug/cpp_parser -Il ./ ./condition.hpp > ./output_condition.txt
+
+if cmp ./output_condition.txt ./condition_expected.txt
+then
+    echo "Conditions output matches"
+else
+    exit 1
+fi
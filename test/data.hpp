@@ -0,0 +1,28 @@
+#ifndef DATA_HPP
+#define DATA_HPP
+
+#define ARGS_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, N, ...) N
+#define COUNT(...) ARGS_N(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define SEQUENCE() \
+    9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+#define COUNT_SEQUENCE(...) COUNT_(__VA_ARGS__, SEQUENCE())
+#define COUNT_(...) ARGS_N(__VA_ARGS__)
+#define FIRST(a, ...) a
+#define BYTE 0xff
+#define OPEN (
+
+unsigned char blob[] = {
+  0x7f, 0x45, 0x4c, 0x46, 0x02, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x02, 0x00, 0x3e, 0x00, 0x01, 0x00, 0x00, 0x00,   0x40,	0x10, 0x40, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, BYTE,
+  1'000, 2e+5, .5, 0x1p-3, 10u, 20ul, 30LL, 1.5f, 'a', 2, 3, 4, 5, 6, 7, 8
+};
+unsigned int blob_len = 48;
+
+int count = COUNT(1, 2, 3, 4, 5, 6, 7, 8, 9);
+int count_sequence = COUNT_SEQUENCE(1, 2, 3);
+int first = FIRST(
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+int values[] = { 1, 2, 3, 4, 5, 6, 7, BYTE, 9, 10, 11, 12, 13, 14, 15, 16 }; /* comment */
+
+#endif
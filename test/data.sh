@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Numeric data test case, lists of numbers are copied as they are unless they are macro arguments or replacements
+../bin/Debug/cpp_parser -Il ./ ./data.hpp > ./output_data.txt
+
+if cmp ./output_data.txt ./data_expected.txt
+then
+    echo "Numeric data output matches"
+else
+    exit 1
+fi
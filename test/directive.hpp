@@ -0,0 +1,61 @@
+#ifndef DIRECTIVE_HPP
+#define DIRECTIVE_HPP
+
+#define ONE 1
+
+#if ONE
+int ok1;
+#else
+int bad1;
+#endif
+
+#if ONE
+int ok2;
+#elif ONE
+int bad2;
+#elif 1 / 0
+int bad3;
+#else
+int bad4;
+#endif
+
+#if 0
+int bad5;
+#elifdef ONE
+int ok3;
+#elifndef ONE
+int bad6;
+#endif
+
+#ifdef UNDEFINED
+int bad7;
+#elifndef UNDEFINED
+int ok4;
+#else
+int bad8;
+#endif
+
+#if 0
+#elif 0
+#else
+int ok5;
+#endif
+
+#pragma pack(push, 1)
+struct packed { char c; int i; };
+  #pragma pack(pop)
+#pragma once
+
+#define LINE 100
+#line LINE "renamed.hpp"
+#define AFTER_LINE 1
+#undef ONE
+
+#ifndef ONE
+int ok6;
+#endif
+
+#warning don't stop at the quote
+int ok7;
+
+#endif // DIRECTIVE_HPP
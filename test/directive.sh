@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Directives test case, only one branch of each conditional group is taken and pragmas are kept on the output
+../bin/Debug/cpp_parser -Il ./ ./directive.hpp > ./output_directive.txt
+
+if cmp ./output_directive.txt ./directive_expected.txt
+then
+    echo "Directives output matches"
+else
+    exit 1
+fi
@@ -0,0 +1,15 @@
+#include "guard_a.h"
+#include "./guard_a.h"
+#include "guard_b.h"
+#include "./guard_b.h"
+#define GUARD_C_NAME first
+#include "guard_c.h"
+#undef GUARD_C_NAME
+#define GUARD_C_NAME second
+#include "guard_c.h"
+#include "guard_d.h"
+#include "guard_d.h"
+#include "guard_e.h"
+#include "guard_e.h"
+#undef GUARD_A_H
+#include "guard_a.h"
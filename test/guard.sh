@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Include guards test case, guarded and #pragma once headers are included once whatever their spelling, the others every time
+../bin/Debug/cpp_parser -Il ./ ./guard.hpp > ./output_guard.txt
+
+if cmp ./output_guard.txt ./guard_expected.txt
+then
+    echo "Include guards output matches"
+else
+    exit 1
+fi
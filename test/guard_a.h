@@ -0,0 +1,5 @@
+// Guarded with #ifndef
+#ifndef GUARD_A_H
+#define GUARD_A_H
+int guard_a;
+#endif
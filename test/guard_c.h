@@ -0,0 +1,2 @@
+/* Meant to be included many times */
+int GUARD_C_NAME;
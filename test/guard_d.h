@@ -0,0 +1,6 @@
+#if !defined(GUARD_D_H)
+#define GUARD_D_H
+int guard_d;
+#endif
+
+/* Only comments after the guard */
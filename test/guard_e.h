@@ -0,0 +1,5 @@
+#ifndef GUARD_E_H
+#define GUARD_E_H
+int guard_e;
+#endif
+int not_guarded_e;
@@ -0,0 +1,36 @@
+#ifndef MACRO_HPP
+#define MACRO_HPP
+
+#define ADD(a, b) ((a) + (b))
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define CAT(a, b) a ## b
+#define f(x) x f
+#define LOG(format, ...) printf(format, ## __VA_ARGS__)
+#define CALL(args...) call(args)
+#define ARRAY(x) [x]
+#define LONG (1 + \
+    2)
+
+int sum = ADD(1, 2);
+const char *text = STR(hello   "world\n");
+const char *expanded = XSTR(ADD(1, 2));
+int CAT(foo, bar) = CAT(1, 2);
+int recursive = f(f)(1);
+LOG("none");
+LOG("%d %d", 1, 2);
+CALL(1, 2);
+int line = LONG;
+int lines = ADD(1,
+    2) + 3;
+int ADD = ADD;
+int next_line[] = ARRAY
+(1);
+int named = ARRAY;
+int after_name;
+
+#if ADD(1, 1) == 2 && defined(LONG) && !defined UNDEFINED
+int condition = 1;
+#endif
+
+#endif
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Macro expansion test case, the output must match the expected expansion
+../bin/Debug/cpp_parser -Il ./ ./macro.hpp > ./output_macro.txt
+
+if cmp ./output_macro.txt ./macro_expected.txt
+then
+    echo "Macro expansion output matches"
+else
+    exit 1
+fi
@@ -0,0 +1,2 @@
+#include <next.h>
+int main_file;
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Include next test case, #include_next continues on the include directories after the one that has the file
+../bin/Debug/cpp_parser -Il ./ -Ig next/first -Ig next/second ./next.hpp > ./output_next.txt
+
+if cmp ./output_next.txt ./next_expected.txt
+then
+    echo "Include next output matches"
+else
+    exit 1
+fi
@@ -0,0 +1,2 @@
+int from_first;
+#include_next <next.h>
@@ -0,0 +1,4 @@
+#include "resolve/outer.h"
+#include "missing.h"
+#include "missing.h"
+#include <resolve/inner.h>
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Include resolution test case, headers enclosed in "" are searched next to the file that includes them first
+../bin/Debug/cpp_parser -Il ./ -Ig ./ ./resolve.hpp > ./output_resolve.txt
+
+if cmp ./output_resolve.txt ./resolve_expected.txt
+then
+    echo "Include resolution output matches"
+else
+    exit 1
+fi
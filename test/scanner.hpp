@@ -0,0 +1,27 @@
+#ifndef SCANNER_HPP
+#define SCANNER_HPP
+
+#include <string>
+
+/*
+ * Long comment that spans multiple lines and crosses the 16 and 32 bytes
+ * boundaries of the vectorized scanners, with some * and / characters that
+ * don't close it: 2 * 3 / 4 ** // *** //
+ **********************************************************************/
+
+/**/ /*/ still a comment */ /***/
+
+int a_very_long_identifier_name_that_is_longer_than_thirty_two_bytes = 1;
+int                                                  spaced_identifier   =   2;
+int	tabbed_identifier	=	3;
+
+const char *text = "a string with \"escaped quotes\" and \\ backslashes that is long enough";
+const char *path = "C:\\folder\\file.txt";
+char quote = '\'';
+char letter = 'x';
+
+#define LONG_MACRO_NAME_WITH_DIGITS_0123456789_AND_UNDERSCORES___ 10
+
+int value = LONG_MACRO_NAME_WITH_DIGITS_0123456789_AND_UNDERSCORES___; /* trailing comment */ int other;
+
+#endif
@@ -0,0 +1,12 @@
+#!/bin/sh
+
+# Vectorized scanners test case, the output must be the same with and without them
+../bin/Debug/cpp_parser -Il ./ -Ig /usr/include/c++/4.4 -Ig /usr/include -Ig /usr/include/c++/4.4/x86_64-linux-gnu -Ig /usr/include/c++/4.4/tr1 -Ig /usr/include/linux ./scanner.hpp > ./output_simd.txt
+../bin/Debug/cpp_parser -ns -Il ./ -Ig /usr/include/c++/4.4 -Ig /usr/include -Ig /usr/include/c++/4.4/x86_64-linux-gnu -Ig /usr/include/c++/4.4/tr1 -Ig /usr/include/linux ./scanner.hpp > ./output_scalar.txt
+
+if cmp ./output_simd.txt ./output_scalar.txt
+then
+    echo "Vectorized and scalar outputs match"
+else
+    exit 1
+fi
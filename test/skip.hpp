@@ -0,0 +1,41 @@
+#ifndef SKIP_HPP
+#define SKIP_HPP
+
+#if 0
+/* A comment hiding a directive
+#endif
+*/
+const char *text = "#endif";
+char quote = '#';
+int number = 1'000; /* comment with ' quote
+#else */
+// continued line comment \
+#endif
+#define CONTINUED \
+#endif
+don't close this quote
+#if 1
+nested
+#else
+nested_else
+#endif
+#elif 0
+int bad2;
+#else
+int ok1;
+#endif
+
+#ifdef UNDEFINED
+   #  if 1
+   int bad3;
+   #  endif
+#endif
+int ok2;
+
+#ifndef SKIP_HPP
+int bad4;
+#elif 1
+int ok3;
+#endif
+
+#endif
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Inactive groups test case, directives hidden in comments, literals and continued lines of skipped groups must be ignored
+../bin/Debug/cpp_parser -Il ./ ./skip.hpp > ./output_skip.txt
+
+if cmp ./output_skip.txt ./skip_expected.txt
+then
+    echo "Skipped groups output matches"
+else
+    exit 1
+fi
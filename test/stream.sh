@@ -0,0 +1,14 @@
+#!/bin/sh
+
+# Streamed files test case, reading the files in small batches must give the same output as reading them whole
+for test in macro condition skip directive guard resolve data
+do
+    ../bin/Debug/cpp_parser -ss 16 -Il ./ -Ig ./ ./$test.hpp > ./output_stream.txt
+
+    if ! cmp ./output_stream.txt ./${test}_expected.txt
+    then
+        exit 1
+    fi
+done
+
+echo "Streamed outputs match"